@@ -0,0 +1,56 @@
+/*
+Counts heap allocations made through operator new, for the allocation benchmarks.
+
+This header replaces the global operator new and delete, so it must be included by exactly one
+source file of a program (the one with main()). Counting costs one relaxed atomic add per allocation.
+*/
+
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace allocation_counter {
+    inline std::atomic<size_t> allocations{0};
+
+    // Number of operator new calls since the program started
+    inline size_t count() {
+        return allocations.load(std::memory_order_relaxed);
+    }
+}
+
+void* operator new(size_t bytes) {
+    allocation_counter::allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(bytes == 0 ? 1 : bytes)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t bytes, std::align_val_t alignment) {
+    allocation_counter::allocations.fetch_add(1, std::memory_order_relaxed);
+    size_t align = static_cast<size_t>(alignment);
+    if (void* memory = std::aligned_alloc(align, (bytes + align - 1) / align * align)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+// GCC sees free() called on memory from operator new once these are inlined and warns,
+// but here operator new is malloc, so the pair matches.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { std::free(memory); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
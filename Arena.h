@@ -0,0 +1,147 @@
+/*
+Arena allocator shared by both assignment programs.
+
+Creating and deleting many small objects one at a time (each with its own `new` and `delete`,
+plus one more for every std::string too long for its small buffer) spends most of its time in malloc.
+A MonotonicArena instead hands out memory from large slabs by moving a pointer forward,
+and frees a whole generation of objects at once with reset().
+
+The arena is also a std::pmr::memory_resource, so pmr::string members (Vehicle::make, Exam::subject, ...)
+can keep their characters in the same slabs as the object that owns them.
+*/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class MonotonicArena : public std::pmr::memory_resource {
+private:
+    // Destructors still to run on reset(), kept as a linked list inside the arena itself
+    struct DestructorNode {
+        void (*destroy)(void*);
+        void* object;
+        DestructorNode* next;
+    };
+
+    std::vector<char*> slabs;           // Slabs of slabSize bytes, kept across resets and reused
+    std::vector<std::pair<void*, size_t>> largeBlocks;  // Allocations bigger than a slab (and their alignment), freed on reset
+    size_t slabSize;
+    size_t currentSlab = 0;             // Index in slabs of the slab being filled
+    char* cursor = nullptr;             // Next free byte in the current slab
+    char* slabEnd = nullptr;
+    DestructorNode* destructors = nullptr;
+    size_t objectCount = 0;             // Objects made since the last reset
+
+    // Moves on to the next slab, allocating one if all the existing slabs are in use
+    void nextSlab() {
+        if (cursor != nullptr) {
+            currentSlab++;
+        }
+        if (currentSlab == slabs.size()) {
+            // Through operator new, like every other heap allocation, so the allocation benchmarks count slabs too
+            slabs.push_back(static_cast<char*>(::operator new(slabSize)));
+        }
+        cursor = slabs[currentSlab];
+        slabEnd = cursor + slabSize;
+    }
+
+    template<typename T>
+    static void destroyObject(void* object) {
+        static_cast<T*>(object)->~T();
+    }
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        if (bytes + alignment > slabSize) {
+            void* block = ::operator new(bytes, std::align_val_t(alignment));
+            largeBlocks.emplace_back(block, alignment);
+            return block;
+        }
+        while (true) {
+            if (cursor != nullptr) {
+                char* aligned = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(cursor) + alignment - 1) & ~uintptr_t(alignment - 1));
+                if (aligned + bytes <= slabEnd) {
+                    cursor = aligned + bytes;
+                    return aligned;
+                }
+            }
+            nextSlab();
+        }
+    }
+
+    // Memory is only given back by reset(), so single deallocations do nothing
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+public:
+    explicit MonotonicArena(size_t slabBytes = 1 << 20) : slabSize(slabBytes) {
+        slabs.reserve(64);      // Room for 64 slabs before the list itself has to grow
+    }
+
+    MonotonicArena(const MonotonicArena&) = delete;
+    MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+    ~MonotonicArena() {
+        reset();
+        for (char* slab : slabs) {
+            ::operator delete(slab);
+        }
+    }
+
+    // Constructs a T in the arena. Its destructor runs on reset(), newest object first.
+    // Any pmr containers inside it should be given this arena as their memory resource.
+    template<typename T, typename... Args>
+    T* make(Args&&... args) {
+        void* memory = allocate(sizeof(T), alignof(T));
+        T* object = ::new (memory) T(std::forward<Args>(args)...);
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            void* nodeMemory = allocate(sizeof(DestructorNode), alignof(DestructorNode));
+            destructors = ::new (nodeMemory) DestructorNode{&destroyObject<T>, object, destructors};
+        }
+        objectCount++;
+        return object;
+    }
+
+    // Constructs a T whose destructor is never run, not even by reset().
+    // Only for objects that own nothing outside the arena (e.g. a Vehicle whose strings use this arena),
+    // where skipping the destructor call and its bookkeeping frees the generation in constant time.
+    template<typename T, typename... Args>
+    T* makeNoDestructor(Args&&... args) {
+        void* memory = allocate(sizeof(T), alignof(T));
+        objectCount++;
+        return ::new (memory) T(std::forward<Args>(args)...);
+    }
+
+    // Ends the current generation: destroys every object made since the last reset and
+    // rewinds to the first slab. The slabs are kept, so the next generation allocates nothing from the heap.
+    void reset() {
+        for (DestructorNode* node = destructors; node != nullptr; node = node->next) {
+            node->destroy(node->object);
+        }
+        destructors = nullptr;
+        for (auto [block, alignment] : largeBlocks) {
+            ::operator delete(block, std::align_val_t(alignment));
+        }
+        largeBlocks.clear();
+        currentSlab = 0;
+        cursor = nullptr;
+        slabEnd = nullptr;
+        objectCount = 0;
+    }
+
+    size_t objects() const { return objectCount; }
+    size_t slabCount() const { return slabs.size(); }
+    size_t reservedBytes() const { return slabs.size() * slabSize; }
+};
+
+#endif
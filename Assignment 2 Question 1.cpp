@@ -11,120 +11,523 @@
 */
 
 #include<iostream>
+#include<string>
+#include<vector>
+#include<span>
+#include<chrono>
+#include<climits>
+#include<random>
+#include<stdexcept>
+#include<memory>
+#include<cstdint>
+#include<string_view>
+#include<cmath>
+#include<cstring>
+#include<atomic>
+#include<thread>
+#include<algorithm>
+#include<memory_resource>
+#include "FileIO.h"
+#include "CommandLine.h"            // parseCount for the count arguments
+#include "BenchmarkSupport.h"       // NullBuffer and secondsSince for the --bench and --stress modes
+#include "Instrumentation.h"
+#include "Vehicles.h"               // Vehicle, Car, SUV, Truck and the pricing, fleet and booking code built on them
 using namespace std;
 
+// Compares the current per-object path with the batch pricer on the same random requests
+// Run with: "Assignment 2 Question 1" --bench
+void runBenchmarks() {
+    const size_t requestCount = 5000000;
+    Car carObj;
+    SUV suvObj;
+    Truck truckObj;
+    Vehicle* fleet[] = { nullptr, &carObj, &suvObj, &truckObj };    // Indexed by VehicleType
 
-class Vehicle {
-    public:
-        string make, model;
-        int year;
-    
-        //A virtual function is a member function of a base class that can be overridden in a derived class.
-        // It allows dynamic (runtime) polymorphism, i.e. the function that gets executed is determined at runtime based on the actual object type.
-        virtual void calculateRentalCost(int days) = 0;    // Pure Virtual function declaration
-
-        // Destructor for Vehicle class
-        // After the programme runs successfully, run the destructor to clear memory
-        // The ~Vehicle() destructor is called multiple times because each derived class (Car, SUV, Truck) calls the base class destructor (Vehicle's destructor) as part of its destruction process.
-        virtual ~Vehicle() {
-            // cout << "Vehicle Destructor Called!" << endl;
-        }
-};
-
-// Derived class
-// Car is a derived/child/sub class of the base/parent/super class Car
-class Car : public Vehicle {
-
-    private:
-        int numDoors = 4;      // Number of doors the Car has
-
-    public:
-        // Constructor to initialize the car details
-        // We overide the variable values in vehicle class if default values are placed
-        Car() {
-            make = "Toyota";
-            model = "Corolla";
-            year = 2020;
+    // Fixed seed so every run prices the same requests
+    mt19937 rng(42);
+    uniform_int_distribution<int> typeDist(1, 3);
+    uniform_int_distribution<int> daysDist(1, 30);
+    vector<RentalRequest> requests(requestCount);
+    for (RentalRequest& request : requests) {
+        request.type = static_cast<VehicleType>(typeDist(rng));
+        request.days = daysDist(rng);
+    }
+    vector<double> costs(requestCount);
+
+    cout << "Pricing " << requestCount << " requests\n";
+
+    // 1. Today's path: one virtual call and one flushed cout line per quote
+    NullBuffer nullBuffer;
+    streambuf* screen = cout.rdbuf(&nullBuffer);
+    auto start = chrono::steady_clock::now();
+    for (const RentalRequest& request : requests) {
+        fleet[static_cast<int>(request.type)]->calculateRentalCost(request.days);
+    }
+    double printSeconds = secondsSince(start);
+    cout.rdbuf(screen);
+
+    // 2. One virtual call per quote, result returned instead of printed
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < requestCount; i++) {
+        costs[i] = fleet[static_cast<int>(requests[i].type)]->quoteRentalCost(requests[i].days);
+    }
+    double virtualSeconds = secondsSince(start);
+    long long virtualCents = totalCents(costs);
+
+    // 3. Batch pricer
+    BatchPricer pricer(carObj, suvObj, truckObj);
+    pricer.priceBatch(requests, costs);     // Warm-up call so the scratch buffer is already allocated
+    start = chrono::steady_clock::now();
+    pricer.priceBatch(requests, costs);
+    double batchSeconds = secondsSince(start);
+    long long batchCents = totalCents(costs);
+
+    cout << "  per-object calculateRentalCost (cout): " << printSeconds * 1e9 / requestCount << " ns/quote\n";
+    cout << "  per-object quoteRentalCost (virtual):  " << virtualSeconds * 1e9 / requestCount << " ns/quote\n";
+    cout << "  BatchPricer::priceBatch:               " << batchSeconds * 1e9 / requestCount << " ns/quote\n";
+    cout << "  Totals in cents (must match): " << virtualCents << " / " << batchCents << endl;
+}
+
+// Times each pricing kernel with every instruction set this CPU has, and checks the results are bit-for-bit the scalar ones
+void runKernelBenchmark() {
+    const size_t count = 16384;     // Small enough to stay in cache, so the arithmetic is timed rather than memory
+    const int repeats = 2000;
+    mt19937 rng(11);
+    uniform_int_distribution<int> daysDist(1, 365), doorsDist(2, 5);
+    uniform_real_distribution<float> cargoDist(1000.0f, 20000.0f);
+    vector<int> days(count), doors(count);
+    vector<float> cargo(count);
+    for (size_t i = 0; i < count; i++) {
+        days[i] = daysDist(rng);
+        doors[i] = doorsDist(rng);
+        cargo[i] = cargoDist(rng);
+    }
+
+    vector<double> reference(count), costs(count);
+    cout << "Pricing kernels, " << count << " rentals per call (best on this CPU: " << kernelIsaName(bestKernelIsa()) << ")\n";
+    for (int kernel = 0; kernel < 2; kernel++) {
+        const char* label = kernel == 0 ? "car  " : "truck";
+        auto run = [&](KernelIsa isa, vector<double>& out) {
+            if (kernel == 0) carRentalCosts(days.data(), doors.data(), 1, out.data(), count, isa);
+            else truckRentalCosts(days.data(), cargo.data(), 1, out.data(), count, isa);
+        };
+        double scalarSeconds = 0;
+        for (KernelIsa isa : { KernelIsa::Scalar, KernelIsa::SSE2, KernelIsa::AVX2 }) {
+            if (isa > bestKernelIsa()) continue;
+            vector<double>& out = isa == KernelIsa::Scalar ? reference : costs;
+            run(isa, out);      // Warm-up
+            auto start = chrono::steady_clock::now();
+            for (int repeat = 0; repeat < repeats; repeat++) {
+                run(isa, out);
+            }
+            double seconds = secondsSince(start);
+            if (isa == KernelIsa::Scalar) scalarSeconds = seconds;
+            bool identical = memcmp(out.data(), reference.data(), count * sizeof(double)) == 0;
+            cout << "  " << label << " " << kernelIsaName(isa) << ":\t" << seconds * 1e9 / (double(count) * repeats) << " ns/rental, "
+                 << scalarSeconds / seconds << "x scalar, " << (identical ? "bit-identical" : "MISMATCH") << "\n";
         }
+    }
+    cout << flush;
+}
+
+// Prices the same cars through a Vehicle* (virtual call) and through the compile-time Pricing<Car> policy
+void runStaticPricingBenchmark() {
+    const size_t fleetSize = 100000;
+    const int repeats = 50;
+    mt19937 rng(5);
+    uniform_int_distribution<int> daysDist(1, 30), doorsDist(2, 5);
+    vector<Car> cars;
+    vector<int> days(fleetSize);
+    cars.reserve(fleetSize);
+    for (size_t i = 0; i < fleetSize; i++) {
+        cars.emplace_back("Toyota", "Corolla", 2020, doorsDist(rng));
+        days[i] = daysDist(rng);
+    }
+    vector<const Vehicle*> vehicles;
+    for (const Car& car : cars) vehicles.push_back(&car);
 
-       // Overriding the base class function to calculate rental cost based on number of doors for this class function
-        void calculateRentalCost(int days) override {
-            float costPerDay = 20.0f; // Cost per day for a car. f indicates the value is explicitly a float
-            float totalCost = costPerDay * days * numDoors; // Number of doors affects cost
-            cout << "Car Chosen! \nTotal Rental Cost: KES" << totalCost << " for " << days << " days." << endl;
-            // cout << "Car Chosen!" << endl;
+    // Every repeat rents for a different number of days and its quotes are added into the total,
+    // so the optimiser cannot fold the repeats into one pass (or skip them) on either path.
+    // Both paths add the same costs in the same order, so the two totals must be identical.
+
+    // Virtual path: load the vtable, call through it, no inlining
+    auto start = chrono::steady_clock::now();
+    double virtualTotal = 0;
+    for (int repeat = 0; repeat < repeats; repeat++) {
+        for (size_t i = 0; i < fleetSize; i++) {
+            virtualTotal += vehicles[i]->quoteRentalCost(days[i] + repeat % 7);
         }
+    }
+    double virtualSeconds = secondsSince(start);
 
-        // Destructor for Car class
-        // After the programme runs successfully, run the destructor to clear memory
-        // The destructor for the derived class is called first, followed by the base class destructor. This ensures that all resources are properly released.
-        ~Car() {
-            // cout << "Car Destructor Called!" << endl;
+    // Static path: the type is known, so Pricing<Car> is inlined into the loop
+    start = chrono::steady_clock::now();
+    double staticTotal = 0;
+    for (int repeat = 0; repeat < repeats; repeat++) {
+        for (size_t i = 0; i < fleetSize; i++) {
+            staticTotal += Pricing<Car>::rentalCost(days[i] + repeat % 7, cars[i].getNumDoors());
         }
-};
+    }
+    double staticSeconds = secondsSince(start);
+
+    double quotes = double(fleetSize) * repeats;
+    cout << "Static vs virtual pricing, " << fleetSize << " cars, " << repeats << " passes\n";
+    cout << "  Vehicle::quoteRentalCost (virtual): " << virtualSeconds * 1e9 / quotes << " ns/quote\n";
+    cout << "  Pricing<Car>::rentalCost (inlined): " << staticSeconds * 1e9 / quotes << " ns/quote\n";
+    cout << "  Totals in cents (must match): " << llround(virtualTotal * 100) << " / " << llround(staticTotal * 100)
+         << (virtualTotal == staticTotal ? "" : " MISMATCH") << endl;
+}
+
+// Approximate size of the heap block glibc's malloc hands out for a request of the given size
+static size_t heapBlockSize(size_t bytes) {
+    size_t block = (bytes + sizeof(size_t) + 15) & ~size_t(15);
+    return block < 32 ? 32 : block;
+}
 
+// Heap bytes of a string, 0 when it fits in the small string buffer inside the object
+static size_t stringHeapBytes(const pmr::string& text) {
+    return text.capacity() > 15 ? heapBlockSize(text.capacity() + 1) : 0;
+}
 
-class SUV : public Vehicle {
-    private:
-     int peopleCapacity = 7;        // Number of people the SUV can carry
+// Compares FleetStore against a vector of heap-allocated Vehicle objects:
+// memory footprint, and a scan for "all SUVs newer than 2020 with capacity >= 7"
+void runFleetStoreBenchmark() {
+    const size_t fleetSize = 500000;
+    const int scanRepeats = 20;
+    const char* makes[][2] = { {"Toyota", "Corolla"}, {"Honda", "Pilot"}, {"Ford", "F-150"}, {"Nissan", "X-Trail"},
+                               {"Mazda", "CX-5"}, {"Isuzu", "D-Max"}, {"Subaru", "Forester"}, {"Mercedes-Benz", "Sprinter Cargo Van"} };
 
-    public:
-        // Constructor to initialize the SUV details
-        // We overide the variable values in vehicle class if default values are placed
-        SUV() {
-            make = "Honda";
-            model = "Pilot";
-            year = 2022;
+    mt19937 rng(7);
+    uniform_int_distribution<int> typeDist(1, 3), nameDist(0, 7), yearDist(2010, 2024), doorsDist(2, 5), peopleDist(5, 9);
+    uniform_real_distribution<float> cargoDist(1000.0f, 20000.0f);
+
+    vector<unique_ptr<Vehicle>> objects;
+    objects.reserve(fleetSize);
+    FleetStore store;
+    for (size_t i = 0; i < fleetSize; i++) {
+        const char** name = makes[nameDist(rng)];
+        int year = yearDist(rng);
+        switch (typeDist(rng)) {
+            case 1: objects.push_back(make_unique<Car>(name[0], name[1], year, doorsDist(rng))); break;
+            case 2: objects.push_back(make_unique<SUV>(name[0], name[1], year, peopleDist(rng))); break;
+            default: objects.push_back(make_unique<Truck>(name[0], name[1], year, cargoDist(rng))); break;
         }
+        store.add(*objects.back());
+    }
+
+    // Footprint of the object baseline: the pointer vector, one heap block per object, and any string that outgrew its small buffer
+    size_t objectBytes = objects.capacity() * sizeof(unique_ptr<Vehicle>);
+    for (const auto& vehicle : objects) {
+        size_t objectSize = vehicle->type() == VehicleType::Car ? sizeof(Car) : vehicle->type() == VehicleType::SUV ? sizeof(SUV) : sizeof(Truck);
+        objectBytes += heapBlockSize(objectSize) + stringHeapBytes(vehicle->make) + stringHeapBytes(vehicle->model);
+    }
+
+    // Scan over the objects: a virtual call and a pointer chase per vehicle
+    vector<const Vehicle*> objectMatches;
+    auto start = chrono::steady_clock::now();
+    for (int repeat = 0; repeat < scanRepeats; repeat++) {
+        objectMatches.clear();
+        for (const auto& vehicle : objects) {
+            if (vehicle->type() == VehicleType::SUV && vehicle->year > 2020 && static_cast<const SUV&>(*vehicle).getPeopleCapacity() >= 7) {
+                objectMatches.push_back(vehicle.get());
+            }
+        }
+    }
+    double objectSeconds = secondsSince(start);
+
+    // Scan over the SUV columns only
+    vector<VehicleId> storeMatches;
+    start = chrono::steady_clock::now();
+    for (int repeat = 0; repeat < scanRepeats; repeat++) {
+        storeMatches.clear();
+        store.findSUVs(2020, 7, storeMatches);
+    }
+    double storeSeconds = secondsSince(start);
+
+    double vehiclesScanned = double(fleetSize) * scanRepeats;
+    cout << "Fleet of " << fleetSize << " vehicles, query: SUVs newer than 2020 with capacity >= 7\n";
+    cout << "  vector<unique_ptr<Vehicle>>: " << objectBytes / 1048576.0 << " MiB, "
+         << vehiclesScanned / objectSeconds / 1e6 << " M vehicles/s, " << objectMatches.size() << " matches\n";
+    cout << "  FleetStore:                  " << store.memoryFootprint() / 1048576.0 << " MiB, "
+         << vehiclesScanned / storeSeconds / 1e6 << " M vehicles/s, " << storeMatches.size() << " matches" << endl;
+}
+
+// Writes an amount of cents as shillings with two decimals, e.g. 175000 as "1750.00"
+// Much cheaper than formatting the double, and gives the same digits as rounding it to 2 decimals.
+static void writeMoney(BufferedWriter& writer, long long cents) {
+    if (cents < 0) {
+        writer.write('-');
+        cents = -cents;
+    }
+    writer.writeInteger(cents / 100);
+    writer.write('.');
+    writer.write(static_cast<char>('0' + cents % 100 / 10));
+    writer.write(static_cast<char>('0' + cents % 10));
+}
+
+// Prices every booking in inputPath and writes "customerId,type,days,cost" lines to outputPath
+// Bookings are read, priced with the BatchPricer and written out in blocks of 64K.
+// Run with: "Assignment 2 Question 1" --batch <bookings file> <quotes file>
+int runBatchFile(const string& inputPath, const string& outputPath) {
+    const size_t blockSize = 65536;
+    const char* typeNames[] = {"", "Car", "SUV", "Truck"};
+    auto start = chrono::steady_clock::now();
 
-        // Overriding the base class function to calculate rental cost based on number of people
-        void calculateRentalCost(int days) override {
-            float costPerDay = 30.0f; // Cost per day for an SUV.  f indicates the value is explicitly a float
-            float totalCost = costPerDay * days * peopleCapacity; // Number of people affects cost
-            cout << "SUV Chosen! \nTotal Rental Cost: KES" << totalCost << " for " << days << " days." << endl;
+    BookingFileReader reader(inputPath);
+    BufferedWriter writer(outputPath, 4 << 20);
+    Car carObj;
+    SUV suvObj;
+    Truck truckObj;
+    BatchPricer pricer(carObj, suvObj, truckObj);
+    vector<RentalRequest> requests(blockSize);
+    vector<uint64_t> customerIds(blockSize);
+    vector<double> costs(blockSize);
+    size_t bookings = 0;
+    long long cents = 0;
+
+    writer.write("customerId,type,days,cost\n");
+    while (size_t count = reader.read(requests.data(), customerIds.data(), blockSize)) {
+        span<const RentalRequest> block(requests.data(), count);
+        pricer.priceBatch(block, costs);
+        for (size_t i = 0; i < count; i++) {
+            writer.writeInteger(customerIds[i]);
+            writer.write(',');
+            writer.write(typeNames[static_cast<int>(requests[i].type)]);
+            writer.write(',');
+            writer.writeInteger(requests[i].days);
+            writer.write(',');
+            writeMoney(writer, llround(costs[i] * 100));
+            writer.write('\n');
         }
+        cents += totalCents(span<const double>(costs.data(), count));
+        bookings += count;
+    }
+    writer.flush();
+    double seconds = secondsSince(start);
 
-        // Destructor for SUV class
-        // After the programme runs successfully, run the destructor to clear memory
-        // The destructor for the derived class is called first, followed by the base class destructor. This ensures that all resources are properly released.
-        ~SUV() {
-            // cout << "SUV Destructor Called!" << endl;
+    cout << "Priced " << bookings << " bookings from " << inputPath << (reader.isBinary() ? " (binary)" : " (CSV)")
+         << ", " << reader.rejected() << " invalid lines skipped\n";
+    cout << "  Total: KES " << cents / 100 << "." << (cents % 100 < 10 ? "0" : "") << cents % 100 << "\n";
+    cout << "  " << reader.fileSize() / 1048576.0 << " MiB read, " << writer.bytesWritten() / 1048576.0 << " MiB written in " << seconds << " s ("
+         << reader.fileSize() / seconds / 1048576.0 << " MiB/s in, " << bookings / seconds / 1e6 << " M bookings/s)" << endl;
+    if (reader.truncated() > 0) {
+        cerr << inputPath << " is truncated: it ends with " << reader.truncated() << " bytes of a "
+             << sizeof(BinaryBooking) << " byte booking record" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Writes count random bookings to path, as CSV or binary, for trying out the batch mode
+// Run with: "Assignment 2 Question 1" --generate-bookings <file> <count> [binary]
+int generateBookingFile(const string& path, size_t count, bool binary) {
+    mt19937_64 rng(2024);
+    uniform_int_distribution<int> typeDist(1, 3), daysDist(1, 30);
+    BufferedWriter writer(path, 4 << 20);
+    if (binary) {
+        writer.write(string_view(binaryBookingMagic, sizeof(binaryBookingMagic)));
+    } else {
+        writer.write("type,days,customerId\n");
+    }
+    for (size_t i = 0; i < count; i++) {
+        int type = typeDist(rng), days = daysDist(rng);
+        uint64_t customerId = 100000 + i;
+        if (binary) {
+            BinaryBooking record = {customerId, days, static_cast<uint8_t>(type), {0, 0, 0}};
+            writer.write(string_view(reinterpret_cast<const char*>(&record), sizeof(record)));
+        } else {
+            writer.writeInteger(type);
+            writer.write(',');
+            writer.writeInteger(days);
+            writer.write(',');
+            writer.writeInteger(customerId);
+            writer.write('\n');
         }
-};
-
-class Truck : public Vehicle {    
-    private:
-     float cargoCapacity = 5000;   // Weight of the cargo the truck can carry in kilograms
-
-    public:
-        // Constructor to initialize the truck details
-        // We overide the variable values in vehicle class if default values are placed
-        Truck() {
-            make = "Ford";
-            model = "F-150";
-            year = 2021;
+    }
+    writer.flush();
+    cout << "Wrote " << count << " bookings to " << path << endl;
+    return 0;
+}
+
+// Stress test for the booking service: clientThreads threads each send bookingsPerClient random requests
+// for overlapping dates on the same vehicleCount vehicles, then every vehicle is checked for double bookings.
+// Run with: "Assignment 2 Question 1" --stress [clientThreads] [vehicleCount]
+int runBookingStressTest(unsigned clientThreads, size_t vehicleCount) {
+    const size_t bookingsPerClient = 50000;
+    vector<unique_ptr<Vehicle>> vehicles;
+    vector<const Vehicle*> fleet;
+    for (size_t i = 0; i < vehicleCount; i++) {
+        switch (i % 3) {
+            case 0: vehicles.push_back(make_unique<Car>()); break;
+            case 1: vehicles.push_back(make_unique<SUV>()); break;
+            default: vehicles.push_back(make_unique<Truck>()); break;
         }
+        vehicles.back()->year = 2015 + static_cast<int>(i % 10);
+        fleet.push_back(vehicles.back().get());
+    }
+    BookingService service(fleet);
+    FleetRevenue revenue;
+    service.trackRevenue(&revenue);
 
-        // Overriding the base class function to calculate rental cost based on cargo capacity
-        void calculateRentalCost(int days) override {
-            float costPerDay = 50.0f; // Cost per day for a truck.  f indicates the value is explicitly a float
-            float totalCost = costPerDay * days * cargoCapacity / 1000; // Cargo weight (in tons) affects cost
-            cout << "Truck Chosen! \nTotal Rental Cost: KES" << totalCost << " for " << days << " days." << endl;
+    const size_t total = bookingsPerClient * clientThreads;
+    vector<BookingRequest> requests(total);
+    vector<BookingResult> results(total);
+    vector<double> latencies(total);    // Seconds from submit to the result being ready
+    atomic<size_t> finished{0};
+
+    auto start = chrono::steady_clock::now();
+    vector<thread> clients;
+    for (unsigned client = 0; client < clientThreads; client++) {
+        clients.emplace_back([&, client] {
+            mt19937 rng(1000 + client);     // Fixed seed per client thread
+            uniform_int_distribution<uint32_t> vehicleDist(0, vehicleCount - 1);
+            uniform_int_distribution<int> firstDayDist(0, 360), daysDist(1, 14);
+            for (size_t k = 0; k < bookingsPerClient; k++) {
+                size_t slot = client * bookingsPerClient + k;
+                requests[slot] = {vehicleDist(rng), firstDayDist(rng), daysDist(rng), slot};
+                auto submitted = chrono::steady_clock::now();
+                service.submit(requests[slot], [&, slot, submitted](const BookingResult& result) {
+                    results[slot] = result;
+                    latencies[slot] = secondsSince(submitted);
+                    finished.fetch_add(1, memory_order_release);
+                });
+            }
+        });
+    }
+    // A dashboard reading the running totals while the bookings are still coming in
+    size_t dashboardReads = 0;
+    long long lastBookings = 0;
+    bool totalsWentBack = false;
+    for (thread& client : clients) client.join();
+    while (finished.load(memory_order_acquire) < total) {
+        RevenueTotal live = revenue.overall();
+        totalsWentBack = totalsWentBack || live.bookings < lastBookings;
+        lastBookings = live.bookings;
+        dashboardReads++;
+        this_thread::yield();
+    }
+    double seconds = secondsSince(start);
+
+    // No double booking: on every vehicle, the successful bookings must not overlap,
+    // and the days they cover must be exactly the days set in the calendar
+    vector<vector<pair<int, int>>> booked(vehicleCount);
+    size_t bookedCount = 0;
+    long long recomputedCents[4] = {0, 0, 0, 0};    // Revenue per type worked out again from every result
+    for (size_t i = 0; i < total; i++) {
+        if (results[i].booked) {
+            booked[requests[i].vehicle].push_back({requests[i].firstDay, requests[i].firstDay + requests[i].days});
+            bookedCount++;
+            recomputedCents[static_cast<int>(fleet[requests[i].vehicle]->type())] += llround(results[i].cost * 100);
+        }
+    }
+    bool revenueMatches = !totalsWentBack;
+    for (VehicleType type : {VehicleType::Car, VehicleType::SUV, VehicleType::Truck}) {
+        revenueMatches = revenueMatches && revenue.forType(type).cents == recomputedCents[static_cast<int>(type)];
+    }
+    size_t doubleBooked = 0;
+    for (size_t v = 0; v < vehicleCount; v++) {
+        sort(booked[v].begin(), booked[v].end());
+        int bookedDays = 0;
+        for (size_t k = 0; k < booked[v].size(); k++) {
+            bookedDays += booked[v][k].second - booked[v][k].first;
+            if (k > 0 && booked[v][k].first < booked[v][k - 1].second) doubleBooked++;
         }
+        if (bookedDays != service.calendar(v).bookedDays()) doubleBooked++;
+    }
+
+    sort(latencies.begin(), latencies.end());
+    cout << "Booking stress test: " << clientThreads << " client threads, " << service.threadCount() << " pool threads, "
+         << vehicleCount << " vehicles, " << total << " requests\n";
+    cout << "  " << bookedCount << " booked, " << total - bookedCount << " refused (dates taken)\n";
+    cout << "  " << total / seconds << " requests/s, " << bookedCount / seconds << " bookings/s\n";
+    cout << "  latency p50 " << latencies[total / 2] * 1e6 << " us, p99 " << latencies[total * 99 / 100] * 1e6 << " us\n";
+    cout << "  double bookings found: " << doubleBooked << "\n";
+    cout << "  revenue: Car KES " << revenue.forType(VehicleType::Car).cents / 100 << ", SUV KES " << revenue.forType(VehicleType::SUV).cents / 100
+         << ", Truck KES " << revenue.forType(VehicleType::Truck).cents / 100 << " (" << dashboardReads << " live reads, "
+         << (revenueMatches ? "matches" : "DOES NOT match") << " the recomputed totals)" << endl;
+
+    // Cancel everything: each booking exactly once, refused requests and second cancels must change nothing
+    size_t badCancels = 0;
+    for (size_t i = 0; i < total; i++) {
+        if (results[i].booked && !service.cancel(results[i].handle)) badCancels++;
+        if (service.cancel(results[i].handle)) badCancels++;
+    }
+    for (size_t v = 0; v < vehicleCount; v++) {
+        if (service.calendar(v).bookedDays() != 0) badCancels++;
+    }
+    RevenueTotal left = revenue.overall();
+    if (left.cents != 0 || left.bookings != 0) badCancels++;     // Every cent booked was taken off exactly once
+    cout << "  cancelled every booking, " << badCancels << " cancellation errors, revenue left KES " << left.cents / 100 << endl;
+
+    // Ranges outside the calendar must be refused even now every day is free, including ones whose end overflows an int
+    const int horizon = ReservationCalendar::horizonDays;
+    const BookingRequest outOfRange[] = { {0, 10, INT_MAX, 1}, {0, horizon - 1, INT_MAX, 2}, {0, INT_MAX, 1, 3}, {0, -1, 5, 4},
+                                          {0, 0, horizon + 1, 5}, {0, 5, 0, 6}, {0, 5, -3, 7} };
+    size_t wrongRanges = 0;
+    for (const BookingRequest& request : outOfRange) {
+        if (service.bookNow(request).booked) wrongRanges++;
+    }
+    if (service.calendar(0).bookedDays() != 0 || revenue.overall().bookings != 0) wrongRanges++;
+    cout << "  " << wrongRanges << " of " << size(outOfRange) << " out of range requests accepted" << endl;
+    return doubleBooked == 0 && revenueMatches && badCancels == 0 && wrongRanges == 0 ? 0 : 1;
+}
+
 
-        // Destructor for Truck class
-        // After the programme runs successfully, run the destructor to clear memory
-        // The destructor for the derived class is called first, followed by the base class destructor. This ensures that all resources are properly released.
-        ~Truck() {
-            // cout << "Truck Destructor Called!" << endl;
+
+int main(int argc, char* argv[]) {
+    // Benchmark mode instead of the interactive menu
+    if (argc > 1 && string(argv[1]) == "--bench") {
+        runBenchmarks();
+        cout << "\n";
+        runFleetStoreBenchmark();
+        cout << "\n";
+        runKernelBenchmark();
+        cout << "\n";
+        runStaticPricingBenchmark();
+
+        // What the timers and counters saw during the benchmarks, also written as JSON if a file is given
+        instrumentation::Snapshot stats = instrumentation::snapshot();
+        cout << "\nInstrumentation:\n" << stats.toText() << flush;
+        if (argc > 2) {
+            BufferedWriter json(argv[2]);
+            json.write(stats.toJson());
+            json.write('\n');
         }
-};
+        return 0;
+    }
 
+    // Non-interactive batch mode: price a whole booking file
+    if (argc > 3 && string(argv[1]) == "--batch") {
+        try {
+            return runBatchFile(argv[2], argv[3]);
+        } catch (const exception& e) {
+            cerr << e.what() << endl;
+            return 1;
+        }
+    }
+    if (argc > 3 && string(argv[1]) == "--generate-bookings") {
+        long long count = parseCount(argv[3], 1000000000);
+        if (count == 0) {
+            cerr << "Usage: --generate-bookings <file> <count 1-1000000000> [binary]" << endl;
+            return 1;
+        }
+        return generateBookingFile(argv[2], static_cast<size_t>(count), argc > 4 && string(argv[4]) == "binary");
+    }
 
+    // Concurrent booking stress test
+    if (argc > 1 && string(argv[1]) == "--stress") {
+        // Both counts must be positive: no requests leave no latencies to take percentiles of, and no vehicles
+        // leave no range to pick one from
+        long long clientThreads = argc > 2 ? parseCount(argv[2], 1024) : 8;
+        long long vehicleCount = argc > 3 ? parseCount(argv[3], UINT32_MAX) : 1000;
+        if (clientThreads == 0 || vehicleCount == 0) {
+            cerr << "Usage: --stress [clientThreads 1-1024] [vehicleCount 1-4294967295]" << endl;
+            return 1;
+        }
+        return runBookingStressTest(static_cast<unsigned>(clientThreads), static_cast<size_t>(vehicleCount));
+    }
 
-int main() {
     // Create an object of the classes above
-    Vehicle* baseVehicle;
     Car carObj;
     SUV suvObj;
     Truck truckObj;
@@ -24,174 +24,537 @@
 #include <iostream>
 #include <string>
 #include <stdexcept>
-#include <cstdlib>
-#include <ctime>
+#include <string_view>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <cmath>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <optional>
+#include <unordered_map>
+#include <filesystem>
+#include "FileIO.h"
+#include "CommandLine.h"          // parseCount for the count arguments
+#include "BenchmarkSupport.h"     // secondsSince for the --bench modes
+#include "Instrumentation.h"
+#include "Exams.h"                // Exam, MultipleChoiceExam, EssayExam and the grading and storage code built on them
 
 using namespace std;
 
-// Abstract base class for Exam
-class Exam {
-protected:
-    string examID; // ID for the exam
-    string subject; // Subject of the exam
-    int duration; // Duration of the exam in minutes
-
-public:
-    // Constructor for Exam class to initialize ID, subject, and duration
-    // Cnstructor takes in arg and we can overide the values in the child/derived/sub class
-    Exam(string id, string sub, int dur){
-        // this is a key word used to reference the variables with a local scope
-        // We equate them to the arguments the function/constructor brings
-         this->examID = id;
-         this->subject = sub; 
-         this->duration = dur;
-        }
-
-    // The constructor uses a member initializer list (: examID(id), subject(sub), duration(dur)) to directly initialize the member variables before entering the body.
-    // This is more efficient, especially for objects like std::string, because it avoids default construction followed by assignment.
-    // Exam(string id, string sub, int dur) : examID(id), subject(sub), duration(dur) {}
-
-    // Pure virtual function for grading exams that must be implemented in derived classes
-    // By overiding we change the functionality of the virtual class
-    // Any class containing this function must be abstract, and any derived class must override this function to be instantiated.
-    virtual void gradeExam() = 0;
-
-    // Virtual destructor for the Exam class to allow proper cleanup of derived class objects
-    virtual ~Exam() {}
-
-    // Getter function to display the details of the exam (ID, subject, and duration)
-    // Getters help us retrieve the data stored in private variables without directly calling the private variable
-    void getExamDetails() const {
-        cout << "Exam ID: " << examID << "\n"
-             << "Subject: " << subject << "\n"
-             << "Duration: " << duration << " minutes\n";
-    }
-};
-
-// Custom Exception Class for invalid exam duration
-// This C++ code defines a custom exception class named InvalidExamDurationException, which is used to handle invalid exam durations.
-// It inherits from the standard std::exception class and overrides the what() function to provide a custom error message.
-class InvalidExamDurationException : public exception {
-public:
-    // Override what() function to provide a custom error message when the exception is thrown
-    const char* what() const noexcept override {
-        return "Error: Invalid exam duration!";
-    }
-};
-
-// Custom Exception Class for grading errors
-class GradingErrorException : public exception {
-public:
-    // Override what() function to provide a custom error message when the exception is thrown
-    const char* what() const noexcept override {
-        return "Error: Grading process failed!";
-    }
-};
-
-// Derived class for MultipleChoiceExam that inherits from base/parent/super class Exam
-class MultipleChoiceExam : public Exam {
-private:
-    int questions; // Number of questions in the multiple choice exam
-
-public:
-    // Constructor for MultipleChoiceExam, which calls the base class constructor
-    // and initializes the number of questions
-    MultipleChoiceExam(string id, string sub, int dur, int q)
-        : Exam(id, sub, dur), questions(q) {}
-
-    // Override the gradeExam function to implement grading logic for MultipleChoiceExam
-    void gradeExam() override {
-        // In C++, the try-catch block is used for exception handling, which allows a program to detect and handle runtime errors gracefully instead of crashing.        
-        // try block → Contains the code that might throw an exception.
-        // catch block → Catches and handles the exception.
-        try {
-            // Check if the exam duration is valid, throw an exception if invalid
-            // If duration is negative or zero, it is considered invalid.
-            if (duration <= 0) {
-                // If the condition is met, the program throws an instance of the InvalidExamDurationException class.
-                // This means the program stops executing the function immediately and transfers control to the nearest catch block that can handle this exception.
-                throw InvalidExamDurationException();
+// Fills writer with a made-up term: examCount exams (one in five an essay) and resultCount results,
+// the multiple choice ones graded by a GradingEngine. The same seed always gives the same file.
+void fillExamStore(ExamStoreWriter& writer, size_t examCount, size_t resultCount, uint64_t seed) {
+    const char* subjects[] = {"Mathematics", "Physics", "Chemistry", "Literature", "History", "Computer Science"};
+    vector<unique_ptr<MultipleChoiceExam>> mcExams;
+    vector<uint32_t> mcIndex, essayIndex;
+    for (size_t i = 0; i < examCount; i++) {
+        string id = (i % 5 == 4 ? "EE" : "MC") + to_string(1000 + i);
+        const char* subject = subjects[splitmix64(seed + i) % 6];
+        if (i % 5 == 4) {
+            essayIndex.push_back(writer.addExam(EssayExam(id, subject, 90, string(subject) + " term paper, part " + to_string(i))));
+        } else {
+            mcExams.push_back(make_unique<MultipleChoiceExam>(id, subject, 60, 20 + static_cast<int>(splitmix64(seed ^ i) % 100)));
+            mcIndex.push_back(writer.addExam(*mcExams.back()));
+        }
+    }
+
+    size_t essayResults = essayIndex.empty() ? 0 : resultCount / 5;
+    vector<Submission> submissions(resultCount - essayResults);
+    for (size_t i = 0; i < submissions.size(); i++) {
+        submissions[i] = {mcExams[i % mcExams.size()].get(), 100000 + i / mcExams.size()};
+    }
+    GradingEngine engine;
+    vector<ExamResult> results = engine.gradeAll(submissions, seed);
+    for (size_t i = 0; i < submissions.size(); i++) {
+        writer.addResult(mcIndex[i % mcIndex.size()], submissions[i].studentId, results[i]);
+    }
+    for (size_t i = 0; i < essayResults; i++) {
+        writer.addResult(essayIndex[i % essayIndex.size()], 100000 + i / essayIndex.size(), ExamResult{static_cast<int>(splitmix64(seed + i) % 101), 100, true});
+    }
+}
+
+// Writes a made-up term of results to path, for --query-results
+int generateResultsFile(const string& path, size_t resultCount) {
+    ExamStoreWriter writer;
+    fillExamStore(writer, 200, resultCount, 2024);
+    writer.save(path);
+    cout << "Wrote " << writer.examCount() << " exams and " << writer.resultCount() << " results to " << path << endl;
+    return 0;
+}
+
+// Prints one exam from an exam store file, and either one student's result or the exam's score summary
+int queryResultsFile(const string& path, string_view examId, optional<uint64_t> studentId) {
+    auto start = chrono::steady_clock::now();
+    ExamStoreReader store(path);
+    optional<size_t> index = store.findExam(examId);
+    if (!index) {
+        cout << "No exam " << examId << " in " << path << endl;
+        return 1;
+    }
+    unique_ptr<Exam> exam = store.restoreExam(*index);
+    exam->getExamDetails();
+    if (studentId) {
+        optional<ExamResult> result = store.findResult(static_cast<uint32_t>(*index), *studentId);
+        if (!result) cout << "Student " << *studentId << ": no result\n";
+        else if (!result->graded) cout << "Student " << *studentId << ": not graded\n";
+        else cout << "Student " << *studentId << ": " << result->score << "/" << result->outOf << "\n";
+    } else {
+        auto [first, last] = store.resultRange(static_cast<uint32_t>(*index));
+        double total = 0;
+        size_t graded = 0;
+        for (size_t i = first; i < last; i++) {
+            ExamResult result = store.result(i).result;
+            if (result.graded) {
+                total += double(result.score) / result.outOf;
+                graded++;
             }
+        }
+        cout << graded << " graded results of " << last - first << ", mean " << (graded ? 100 * total / graded : 0) << "%\n";
+    }
+    cout << "(" << store.resultCount() << " results in the file, answered in " << chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e3 << " ms)" << endl;
+    return 0;
+}
 
-            // Simulate grading by generating a random score between 0 and the number of questions
-            // Zero being the lower limit and number of questions being the upper limit of the random number
-            srand(time(0)); // Seed the random number generator with the current time
-                            // srand(seed) is used to initialize the random number generator
-                            // Using time(0) ensures randomness each time the program is executed
-            int score = rand() % (questions + 1); // Generate a random score
-                                                  // rand() generates a pseudo-random integer between 0 and RAND_MAX (a very large number, typically 32767)
-                                                  // % (questions + 1) restricts the random number to the range [0, questions]
-                                                  // If questions = 10, then rand() % (10 + 1) produces a number between 0 and 10 (inclusive) ensuring we stay within the range scope  
-
-            cout << "Grading Multiple Choice Exam..." << endl;
-            cout << "Score: " << score << "/" << questions << " correct answers" << endl;
-        } catch (const exception& e) {
-            // Catch and display any exceptions that occur during grading
-            cout << e.what() << endl;
+// Grades the same submissions with 1, 2, 4, ... threads, checks every run gives the same results, and reports throughput
+void runGradingBenchmark() {
+    const size_t submissionCount = 4000000;
+    const uint64_t seed = 2024;
+    vector<MultipleChoiceExam> exams;
+    for (int i = 0; i < 100; i++) {
+        exams.emplace_back("MC" + to_string(100 + i), "Mathematics", i % 50 == 49 ? 0 : 60, 20 + i % 30);   // 2 in 100 have an invalid duration
+    }
+    vector<Submission> submissions(submissionCount);
+    for (size_t i = 0; i < submissionCount; i++) {
+        submissions[i] = {&exams[i % exams.size()], i};
+    }
+
+    // Powers of two, then always the real core count even when it is not a power of two (e.g. 6 or 12 cores).
+    // At least 4 threads are measured so a small machine still shows what oversubscribing does.
+    unsigned cores = max(thread::hardware_concurrency(), 1u);
+    unsigned maxThreads = max(cores, 4u);
+    vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+    if (find(threadCounts.begin(), threadCounts.end(), cores) == threadCounts.end()) {
+        threadCounts.insert(lower_bound(threadCounts.begin(), threadCounts.end(), cores), cores);
+    }
+
+    vector<ExamResult> reference;
+    double oneThreadSeconds = 0;
+    cout << "Grading " << submissionCount << " multiple choice submissions (" << cores << " cores)\n";
+    for (unsigned threads : threadCounts) {
+        GradingEngine engine(threads);
+        engine.gradeAll(submissions, seed);     // Warm-up
+        auto start = chrono::steady_clock::now();
+        vector<ExamResult> results = engine.gradeAll(submissions, seed);
+        double seconds = secondsSince(start);
+        if (threads == 1) {
+            reference = results;
+            oneThreadSeconds = seconds;
         }
+        bool same = true;
+        for (size_t i = 0; i < submissionCount && same; i++) {
+            same = results[i].score == reference[i].score && results[i].graded == reference[i].graded;
+        }
+        cout << "  " << threads << " thread(s): " << submissionCount / seconds / 1e6 << " M submissions/s, "
+             << oneThreadSeconds / seconds << "x, results " << (same ? "identical" : "DIFFERENT") << "\n";
     }
 
-    // Destructor for MultipleChoiceExam (empty, as no resources are dynamically allocated)
-    ~MultipleChoiceExam() {}
-};
+    // Once more with running score summaries, checked against the mean worked out from the results
+    GradingEngine engine;
+    ScoreAggregates scores;
+    engine.trackScores(&scores);
+    auto start = chrono::steady_clock::now();
+    vector<ExamResult> results = engine.gradeAll(submissions, seed);
+    double seconds = secondsSince(start);
+    uint64_t basisPoints = 0, graded = 0;
+    for (const ExamResult& result : results) {
+        if (result.graded) {
+            basisPoints += (uint64_t(result.score) * 10000 + result.outOf / 2) / result.outOf;
+            graded++;
+        }
+    }
+    const ScoreSketch& mathematics = *scores.subject("Mathematics");
+    bool matches = mathematics.count() == graded && llround(mathematics.mean() * 100) == llround(basisPoints / double(graded));
+    cout << "  with score aggregates: " << submissionCount / seconds / 1e6 << " M submissions/s, Mathematics mean "
+         << mathematics.mean() << "%, p50 " << mathematics.percentile(0.5) << "%, p90 " << mathematics.percentile(0.9) << "% ("
+         << (matches ? "matches" : "DOES NOT match") << " the results)" << endl;
+}
 
-// Derived class for EssayExam that inherits from Exam
-class EssayExam : public Exam {
-private:
-    string topic; // The essay topic
+// Marks a cohort of 100,000 students on a 200 question paper in one pass
+// Each student has an ability, and answers a question correctly with a probability that rises with ability
+// and falls with the question's difficulty, so the statistics have something to find.
+void runCohortBenchmark() {
+    const int questionCount = 200;
+    const size_t studentCount = 100000;
+    mt19937_64 rng(99);
+    uniform_real_distribution<double> uniform(0.0, 1.0);
+    uniform_int_distribution<int> option(0, 3);
+
+    AnswerSheet key(questionCount);
+    vector<double> easiness(questionCount);
+    for (int q = 0; q < questionCount; q++) {
+        key.setAnswer(q, option(rng));
+        easiness[q] = uniform(rng);
+    }
+    MultipleChoiceExam exam("MC200", "Statistics", 120, key);
+
+    CohortAnswers cohort(questionCount, studentCount);
+    for (size_t s = 0; s < studentCount; s++) {
+        double ability = uniform(rng);
+        for (int q = 0; q < questionCount; q++) {
+            if (uniform(rng) < 0.1) continue;   // Left blank
+            bool knows = uniform(rng) < 0.5 * ability + 0.5 * easiness[q];
+            cohort.setAnswer(s, q, knows ? key.answer(q) : option(rng));
+        }
+    }
 
-public:
-    // Constructor for EssayExam, which calls the base class constructor
-    // and initializes the essay topic
-    // EssayExam is the constructor for this class
-    // The Exam(id, sub, dur) part calls the base class constructor (from the Exam class).
-    // The topic(t) part initializes the private topic member of EssayExam.
-    EssayExam(string id, string sub, int dur, string t) : Exam(id, sub, dur), topic(t) {}
+    exam.gradeCohort(cohort);   // Warm-up
+    const int repeats = 10;
+    auto start = chrono::steady_clock::now();
+    CohortReport report;
+    for (int repeat = 0; repeat < repeats; repeat++) {
+        report = exam.gradeCohort(cohort);
+    }
+    double seconds = secondsSince(start) / repeats;
 
+    int hardest = 0, easiest = 0;
+    for (int q = 1; q < questionCount; q++) {
+        if (report.questions[q].difficulty < report.questions[hardest].difficulty) hardest = q;
+        if (report.questions[q].difficulty > report.questions[easiest].difficulty) easiest = q;
+    }
+    cout << "Cohort of " << studentCount << " students x " << questionCount << " questions marked in " << seconds * 1e3 << " ms ("
+         << studentCount / seconds / 1e6 << " M sheets/s)\n";
+    cout << "  mean score " << report.meanScore << "/" << questionCount << ", standard deviation " << report.scoreDeviation << "\n";
+    cout << "  hardest question " << hardest + 1 << ": p = " << report.questions[hardest].difficulty << ", discrimination " << report.questions[hardest].discrimination << "\n";
+    cout << "  easiest question " << easiest + 1 << ": p = " << report.questions[easiest].difficulty << ", discrimination " << report.questions[easiest].discrimination << endl;
+}
 
-    // In the alternative below, the member topic is now initialized inside the constructor body instead of using : topic(t).
-    // EssayExam(string id, string sub, int dur, string t) : Exam(id, sub, dur) {
-    //     this->topic = t;
-    // }
+// Grades records where 1%, 10% and 50% are invalid, once through the throwing API and once through the noexcept one
+// Half the records are multiple choice exams (invalid: zero duration), half are essay scores (invalid: above 100).
+void runValidationBenchmark() {
+    const size_t recordCount = 1000000;
+    MultipleChoiceExam validExam("MC101", "Mathematics", 60, 20), invalidExam("MC102", "Mathematics", 0, 20);
+    EssayExam essay("EE101", "Literature", 90, "Qunatum Computing Term Paper");
+    struct Record {
+        const MultipleChoiceExam* exam;     // nullptr for an essay record
+        int essayScore;
+    };
+
+    cout << "Grading " << recordCount << " records with invalid ones mixed in\n";
+    for (int invalidPercent : {1, 10, 50}) {
+        mt19937_64 rng(invalidPercent);
+        uniform_int_distribution<int> percent(0, 99), score(0, 100);
+        vector<Record> records(recordCount);
+        for (Record& record : records) {
+            bool invalid = percent(rng) < invalidPercent;
+            if (percent(rng) < 50) {
+                record = {invalid ? &invalidExam : &validExam, 0};
+            } else {
+                record = {nullptr, invalid ? 101 + score(rng) : score(rng)};
+            }
+        }
 
-    // Override the gradeExam function to implement grading logic for EssayExam
-    void gradeExam() override {
-        // In C++, the try-catch block is used for exception handling, which allows a program to detect and handle runtime errors gracefully instead of crashing.
-        // try block → Contains the code that might throw an exception.
-        // catch block → Catches and handles the exception.
-        try {
-            // Check if the exam duration is valid, throw an exception if invalid
-            // If duration is negative or zero, it is considered invalid.
-            if (duration <= 0) {
-                // If the condition is met, the program throws an instance of the InvalidExamDurationException class.
-                // This means the program stops executing the function immediately and transfers control to the nearest catch block that can handle this exception.
-                throw InvalidExamDurationException();
+        // Exceptions: every invalid record throws and is caught
+        size_t graded = 0, failed = 0;
+        long long total = 0;
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < recordCount; i++) {
+            try {
+                ExamResult result = records[i].exam ? records[i].exam->grade(splitmix64(i)) : essay.grade(records[i].essayScore);
+                total += result.score;
+                graded++;
+            } catch (const exception&) {
+                failed++;
+            }
+        }
+        double exceptionSeconds = secondsSince(start);
+
+        // noexcept: invalid records come back as a GradeError
+        size_t gradedFast = 0, failedFast = 0;
+        long long totalFast = 0;
+        start = chrono::steady_clock::now();
+        for (size_t i = 0; i < recordCount; i++) {
+            Expected<ExamResult> outcome = records[i].exam ? records[i].exam->tryGrade(splitmix64(i)) : essay.tryGrade(records[i].essayScore);
+            if (outcome) {
+                totalFast += outcome.value().score;
+                gradedFast++;
+            } else {
+                failedFast++;
             }
+        }
+        double fastSeconds = secondsSince(start);
+
+        cout << "  " << invalidPercent << "% invalid: exceptions " << exceptionSeconds * 1e9 / recordCount << " ns/record, noexcept "
+             << fastSeconds * 1e9 / recordCount << " ns/record (" << exceptionSeconds / fastSeconds << "x), "
+             << failed << " invalid" << (graded == gradedFast && failed == failedFast && total == totalFast ? "" : " MISMATCH") << "\n";
+    }
+    cout << flush;
+}
+
+// Keeps thousands of essays in flight through an EssayGradingService and reports queue depth and latency
+// Scores come from scorePath (a ScriptedGrader) when given, otherwise from simulated graders who each take
+// a few microseconds per essay and now and then type a score above 100.
+void runEssayQueueBenchmark(const string& scorePath = "") {
+    const size_t essayCount = 200000;
+    const unsigned graderCount = 8, submitterCount = 4;
+    EssayExam essay("EE101", "Literature", 90, "Qunatum Computing Term Paper");
+
+    EssayGrader grader;
+    if (!scorePath.empty()) {
+        grader = ScriptedGrader(scorePath);
+    } else {
+        grader = [](const EssaySubmission& submission) {
+            uint64_t bits = splitmix64(submission.studentId);
+            auto until = chrono::steady_clock::now() + chrono::microseconds(2 + bits % 8);
+            while (chrono::steady_clock::now() < until) {}      // Reading the essay
+            return bits % 200 == 0 ? 150 : static_cast<int>((bits >> 8) % 101);
+        };
+    }
+
+    atomic<size_t> graded{0}, badScores{0};
+    size_t retries = 0;
+    mutex retriesLock;
+    auto start = chrono::steady_clock::now();
+    {
+        EssayGradingService service(8192, graderCount, grader);
+        vector<thread> submitters;
+        for (unsigned t = 0; t < submitterCount; t++) {
+            submitters.emplace_back([&, t] {
+                size_t myRetries = 0;
+                for (size_t i = t; i < essayCount; i += submitterCount) {
+                    auto done = [&](const Expected<ExamResult>& result) {
+                        (result ? graded : badScores).fetch_add(1, memory_order_relaxed);
+                    };
+                    while (!service.submit(EssaySubmission{&essay, i}, done)) {
+                        myRetries++;                // Queue full: do something else and try again
+                        this_thread::yield();
+                    }
+                }
+                lock_guard<mutex> lock(retriesLock);
+                retries += myRetries;
+            });
+        }
+        for (thread& submitter : submitters) submitter.join();
+        while (!service.idle()) {
+            this_thread::sleep_for(chrono::microseconds(100));
+        }
+        double seconds = secondsSince(start);
+        EssayQueueMetrics metrics = service.metrics();
+
+        cout << "Essay grading queue: " << essayCount << " essays, " << submitterCount << " submitters, " << graderCount << " graders"
+             << (scorePath.empty() ? " (simulated)" : " (scores from " + scorePath + ")") << "\n";
+        cout << "  " << essayCount / seconds << " essays/s, " << graded.load() << " graded, " << badScores.load() << " rejected scores (outside 0-100)\n";
+        cout << "  queue depth: max " << metrics.maxDepth << ", mean " << metrics.meanDepth << " of " << 8192 << ", " << retries << " submissions retried while full\n";
+        cout << "  latency: p50 " << metrics.latencyP50 * 1e3 << " ms, p99 " << metrics.latencyP99 * 1e3 << " ms, max " << metrics.latencyMax * 1e3 << " ms" << endl;
+    }
+}
+
+// Compares restarting from an exam store file with reloading the same results from CSV text
+// The CSV baseline is parsed in place with from_chars (no getline or stringstream), so the difference is the format itself.
+void runStoreBenchmark() {
+    const size_t resultCount = 4000000, lookups = 100000;
+    string binaryPath = (filesystem::temp_directory_path() / "exam-store-bench.bin").string();
+    string csvPath = (filesystem::temp_directory_path() / "exam-store-bench.csv").string();
+
+    ExamStoreWriter writer;
+    fillExamStore(writer, 200, resultCount, 2024);
+    writer.save(binaryPath);
+    {
+        ExamStoreReader store(binaryPath);
+        BufferedWriter csv(csvPath, 4 << 20);
+        csv.write("examID,studentId,score,outOf\n");
+        for (size_t i = 0; i < store.resultCount(); i++) {
+            StoredResult stored = store.result(i);
+            csv.write(store.exam(stored.examIndex).id);
+            csv.write(',');
+            csv.writeInteger(stored.studentId);
+            csv.write(',');
+            csv.writeInteger(stored.result.score);
+            csv.write(',');
+            csv.writeInteger(stored.result.outOf);
+            csv.write('\n');
+        }
+    }
+
+    // The same random (exam, student) questions for both formats
+    vector<pair<string, uint64_t>> questions(lookups);
+    {
+        ExamStoreReader store(binaryPath);
+        for (size_t i = 0; i < lookups; i++) {
+            uint64_t bits = splitmix64(i);
+            questions[i] = {string(store.exam(bits % store.examCount()).id), 100000 + (bits >> 32) % 25000};
+        }
+    }
 
-            // Simulate grading by asking the grader to enter a score
-            // Lecturer enters the score but in multiple choice, the system calculates how many questions the student got right
-            int score;
-            cout << "Enter score for the Essay Exam (0-100): ";
-            cin >> score;
+    // CSV: parse every line into memory before the first question can be answered
+    auto start = chrono::steady_clock::now();
+    vector<StoredResult> loaded;
+    unordered_map<string, uint32_t> examIndex;
+    {
+        MappedFile file(csvPath);
+        const char* cursor = file.data();
+        const char* end = file.data() + file.size();
+        cursor = static_cast<const char*>(memchr(cursor, '\n', end - cursor)) + 1;     // Header line
+        loaded.reserve(resultCount);
+        while (cursor < end) {
+            const char* lineEnd = static_cast<const char*>(memchr(cursor, '\n', end - cursor));
+            const char* comma = static_cast<const char*>(memchr(cursor, ',', lineEnd - cursor));
+            auto [found, added] = examIndex.try_emplace(string(cursor, comma), static_cast<uint32_t>(examIndex.size()));
+            StoredResult row = {0, found->second, ExamResult{}};
+            auto student = from_chars(comma + 1, lineEnd, row.studentId);
+            auto score = from_chars(student.ptr + 1, lineEnd, row.result.score);
+            from_chars(score.ptr + 1, lineEnd, row.result.outOf);
+            row.result.graded = row.result.outOf > 0;
+            loaded.push_back(row);
+            cursor = lineEnd + 1;
+        }
+    }
+    double csvLoadSeconds = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    size_t csvFound = 0;
+    for (const auto& [examId, studentId] : questions) {
+        uint32_t exam = examIndex.at(examId);
+        auto row = lower_bound(loaded.begin(), loaded.end(), pair(exam, studentId), [](const StoredResult& r, const pair<uint32_t, uint64_t>& key) {
+            return r.examIndex != key.first ? r.examIndex < key.first : r.studentId < key.second;
+        });
+        csvFound += row != loaded.end() && row->examIndex == exam && row->studentId == studentId;
+    }
+    double csvLookupSeconds = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    long long csvTotal = 0;
+    for (const StoredResult& row : loaded) csvTotal += row.result.score;
+    double csvScanSeconds = secondsSince(start);
+
+    // Exam store: map the file and check every record in it, then answer straight from the mapping
+    start = chrono::steady_clock::now();
+    ExamStoreReader store(binaryPath);
+    double binaryLoadSeconds = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    size_t binaryFound = 0;
+    for (const auto& [examId, studentId] : questions) {
+        binaryFound += store.findResult(static_cast<uint32_t>(*store.findExam(examId)), studentId).has_value();
+    }
+    double binaryLookupSeconds = secondsSince(start);
+
+    start = chrono::steady_clock::now();
+    long long binaryTotal = 0;
+    for (size_t i = 0; i < store.resultCount(); i++) binaryTotal += store.result(i).result.score;
+    double binaryScanSeconds = secondsSince(start);
+
+    cout << "Exam store: " << store.examCount() << " exams, " << store.resultCount() << " results\n";
+    cout << "  CSV:    " << filesystem::file_size(csvPath) / 1e6 << " MB, load " << csvLoadSeconds * 1e3 << " ms, "
+         << lookups << " lookups " << csvLookupSeconds * 1e3 << " ms, full scan " << csvScanSeconds * 1e3 << " ms\n";
+    cout << "  binary: " << store.fileSize() / 1e6 << " MB, open " << binaryLoadSeconds * 1e3 << " ms, "
+         << lookups << " lookups " << binaryLookupSeconds * 1e3 << " ms, full scan " << binaryScanSeconds * 1e3 << " ms\n";
+    cout << "  Restart " << csvLoadSeconds / binaryLoadSeconds << "x faster, " << binaryFound << " of " << lookups << " found"
+         << (csvFound == binaryFound && csvTotal == binaryTotal ? "" : " MISMATCH") << endl;
+
+    filesystem::remove(binaryPath);
+    filesystem::remove(csvPath);
+}
 
-            // If the score is out of the valid range, throw a grading error exception
-            if (score < 0 || score > 100) {
-                throw GradingErrorException();
+// Measures what a ScopedTimer adds to a short call: multiple choice tryGrade with and without one around it
+// Built with -DRIMS_INSTRUMENTATION=0 the two loops compile to the same code and the overhead is within noise.
+void runInstrumentationBenchmark() {
+    static instrumentation::Timer overheadTimer("bench.timedTryGrade");
+    const size_t calls = 5000000;
+    MultipleChoiceExam exam("MC101", "Mathematics", 60, 100);
+
+    auto bestOfThree = [&](auto&& gradeOne) {
+        double best = 1e9;
+        long long total = 0;
+        for (int round = 0; round < 3; round++) {
+            total = 0;
+            auto start = chrono::steady_clock::now();
+            for (size_t i = 0; i < calls; i++) {
+                total += gradeOne(i);
             }
+            best = min(best, secondsSince(start));
+        }
+        return pair(best, total);
+    };
+    auto [plainSeconds, plainTotal] = bestOfThree([&](size_t i) {
+        return exam.tryGrade(splitmix64(i)).value().score;
+    });
+    auto [timedSeconds, timedTotal] = bestOfThree([&](size_t i) {
+        instrumentation::ScopedTimer timing(overheadTimer);
+        return exam.tryGrade(splitmix64(i)).value().score;
+    });
+
+    cout << "Instrumentation overhead (" << (instrumentation::enabled ? "enabled" : "compiled out") << "), " << calls << " tryGrade calls\n";
+    cout << "  plain:            " << plainSeconds * 1e9 / calls << " ns/call\n";
+    cout << "  with ScopedTimer: " << timedSeconds * 1e9 / calls << " ns/call (+" << (timedSeconds - plainSeconds) * 1e9 / calls << " ns)"
+         << (plainTotal == timedTotal ? "" : " MISMATCH") << endl;
+}
 
-            cout << "Grading Essay Exam..." << endl;
-            cout << "Score: " << score << "/100" << endl;
+int main(int argc, char* argv[]) {
+    // Benchmark mode instead of the exam demonstration
+    if (argc > 1 && string(argv[1]) == "--bench") {
+        runGradingBenchmark();
+        cout << "\n";
+        runCohortBenchmark();
+        cout << "\n";
+        runValidationBenchmark();
+        cout << "\n";
+        runEssayQueueBenchmark();
+        cout << "\n";
+        runStoreBenchmark();
+        cout << "\n";
+        runInstrumentationBenchmark();
+
+        // What the timers and counters saw during the benchmarks, also written as JSON if a file is given
+        instrumentation::Snapshot stats = instrumentation::snapshot();
+        cout << "\nInstrumentation:\n" << stats.toText() << flush;
+        if (argc > 2) {
+            BufferedWriter json(argv[2]);
+            json.write(stats.toJson());
+            json.write('\n');
+        }
+        return 0;
+    }
+
+    // Exam store files: write a made-up term of results, or answer a question from one
+    if (argc > 3 && string(argv[1]) == "--generate-results") {
+        long long count = parseCount(argv[3], 1000000000);
+        if (count == 0) {
+            cerr << "Usage: --generate-results <file> <count 1-1000000000>" << endl;
+            return 1;
+        }
+        return generateResultsFile(argv[2], static_cast<size_t>(count));
+    }
+    if (argc > 3 && string(argv[1]) == "--query-results") {
+        try {
+            return queryResultsFile(argv[2], argv[3], argc > 4 ? optional<uint64_t>(stoull(argv[4])) : nullopt);
         } catch (const exception& e) {
-            // Catch and display any exceptions that occur during grading
             cout << e.what() << endl;
+            return 1;
         }
     }
 
-    // Destructor for EssayExam (empty, as no resources are dynamically allocated)
-    ~EssayExam() {}
-};
+    // Essay grading queue fed with scores from a file
+    if (argc > 2 && string(argv[1]) == "--grade-essays") {
+        try {
+            runEssayQueueBenchmark(argv[2]);
+        } catch (const exception& e) {
+            cout << e.what() << endl;
+            return 1;
+        }
+        return 0;
+    }
 
-int main() {
     // In C++, the try-catch block is used for exception handling, which allows a program to detect and handle runtime errors gracefully instead of crashing.
         // try block → Contains the code that might throw an exception.
         // catch block → Catches and handles the exception.
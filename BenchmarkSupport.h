@@ -0,0 +1,26 @@
+/*
+Small helpers shared by the benchmark modes of both assignment programs and the benchmark suite.
+
+NullBuffer lets a benchmark time code that prints to cout without the terminal being part of the time,
+and secondsSince turns a steady_clock start time into elapsed seconds.
+*/
+
+#ifndef BENCHMARK_SUPPORT_H
+#define BENCHMARK_SUPPORT_H
+
+#include <chrono>
+#include <streambuf>
+
+// Stream buffer that throws away everything written to it
+// Point cout at it (cout.rdbuf(&buffer)) to time printing code such as calculateRentalCost
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+};
+
+// Seconds elapsed since start
+inline double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+#endif
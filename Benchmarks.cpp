@@ -0,0 +1,643 @@
+/*
+Reproducible benchmark suite for both assignment programs.
+
+Every benchmark builds its input from a fixed seed (only if it is selected), runs a few warm-up rounds (to fill caches, fault in
+memory and let the CPU reach its clock speed), then times a number of rounds and writes one CSV row
+with the best, median, mean and worst time per item. Each round returns a checksum of its results,
+so the compiler cannot drop the work and a changed result shows up next to a changed time.
+
+Run with:
+    benchmarks [--seed N] [--warmup N] [--repetitions N] [--scale X] [--filter text] [--output file.csv] [--list]
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "AllocationCounter.h"    // Only included here, it replaces the global operator new
+#include "BenchmarkSupport.h"
+#include "Vehicles.h"
+#include "Exams.h"
+
+using namespace std;
+
+// One benchmark: a group and name for the CSV, and a function that does one round of items work items
+struct BenchmarkCase {
+    string group;
+    string name;
+    size_t items;
+    function<void()> prepare;   // Builds the inputs run uses, before the warm-up and untimed
+    function<uint64_t()> run;   // Returns a checksum of the round's results
+};
+
+// An input shared by some benchmarks of a group, built the first time one of them is prepared.
+// Copies share the one input, so each benchmark's lambdas capture it by value and read it with -> and *,
+// and --list or a --filter that skips a benchmark never pays for building its input.
+template<typename T>
+class LazyInput {
+    struct State {
+        function<unique_ptr<T>()> build;
+        unique_ptr<T> value;
+    };
+    shared_ptr<State> state;
+
+public:
+    explicit LazyInput(function<unique_ptr<T>()> build) : state(make_shared<State>(State{std::move(build), nullptr})) {}
+
+    T& operator*() const {
+        if (!state->value) state->value = state->build();
+        return *state->value;
+    }
+    T* operator->() const { return &**this; }
+};
+
+// The prepare function of a benchmark that reads the given inputs
+template<typename... Inputs>
+static function<void()> prepareInputs(Inputs... inputs) {
+    return [inputs...] { (static_cast<void>(*inputs), ...); };
+}
+
+struct BenchmarkOptions {
+    uint64_t seed = 2024;
+    int warmup = 2;
+    int repetitions = 7;
+    double scale = 1.0;         // Multiplies every benchmark's item count
+    string filter;              // Only run benchmarks whose group/name contains this
+    string output;              // CSV file, standard output if empty
+    bool list = false;
+};
+
+// Random fleet of count vehicles (a third of each type) and matching rental requests
+struct PricingInput {
+    vector<unique_ptr<Vehicle>> fleet;
+    vector<RentalRequest> requests;
+};
+
+static unique_ptr<PricingInput> makePricingInput(size_t count, uint64_t seed) {
+    auto input = make_unique<PricingInput>();
+    mt19937_64 rng(seed);
+    uniform_int_distribution<int> typeDist(1, 3), daysDist(1, 30);
+    input->fleet.push_back(make_unique<Car>());
+    input->fleet.push_back(make_unique<SUV>());
+    input->fleet.push_back(make_unique<Truck>());
+    input->requests.resize(count);
+    for (RentalRequest& request : input->requests) {
+        request = {static_cast<VehicleType>(typeDist(rng)), daysDist(rng)};
+    }
+    return input;
+}
+
+// Days and doors of count cars, as contiguous arrays for the pricing kernels
+struct KernelInput {
+    vector<int> days;
+    vector<int> doors;
+};
+
+static uint64_t checksumOf(double value) {
+    return static_cast<uint64_t>(llround(value * 100));
+}
+
+static void addPricingBenchmarks(vector<BenchmarkCase>& cases, const BenchmarkOptions& options) {
+    const size_t count = static_cast<size_t>(1000000 * options.scale);
+    const uint64_t seed = options.seed;
+    LazyInput<PricingInput> input([count, seed] { return makePricingInput(count, seed); });
+
+    // One virtual quoteRentalCost call per request, through the base class pointer
+    cases.push_back({"pricing", "virtual_quote_per_object", count, prepareInputs(input), [input] {
+        double total = 0;
+        for (const RentalRequest& request : input->requests) {
+            total += input->fleet[static_cast<int>(request.type) - 1]->quoteRentalCost(request.days);
+        }
+        return checksumOf(total);
+    }});
+
+    // The original path: calculateRentalCost prints every quote (here into a stream that discards it)
+    cases.push_back({"pricing", "virtual_calculate_and_print", count, prepareInputs(input), [input] {
+        NullBuffer discard;
+        streambuf* original = cout.rdbuf(&discard);
+        for (const RentalRequest& request : input->requests) {
+            input->fleet[static_cast<int>(request.type) - 1]->calculateRentalCost(request.days);
+        }
+        cout.rdbuf(original);
+        return uint64_t(input->requests.size());
+    }});
+
+    LazyInput<BatchPricer> pricer([input] {
+        return make_unique<BatchPricer>(static_cast<const Car&>(*input->fleet[0]), static_cast<const SUV&>(*input->fleet[1]),
+                                        static_cast<const Truck&>(*input->fleet[2]));
+    });
+    LazyInput<vector<double>> costs([count] { return make_unique<vector<double>>(count); });
+    cases.push_back({"pricing", "batch_pricer", count, prepareInputs(input, pricer, costs), [input, pricer, costs] {
+        pricer->priceBatch(input->requests, *costs);
+        return static_cast<uint64_t>(totalCents(*costs));
+    }});
+
+    // Car pricing kernel over contiguous arrays, with every instruction set this CPU supports
+    LazyInput<KernelInput> cars([count, seed] {
+        auto cars = make_unique<KernelInput>();
+        cars->days.resize(count);
+        cars->doors.resize(count);
+        mt19937_64 rng(seed + 1);
+        for (size_t i = 0; i < count; i++) {
+            cars->days[i] = 1 + static_cast<int>(rng() % 30);
+            cars->doors[i] = 2 + static_cast<int>(rng() % 4);
+        }
+        return cars;
+    });
+    for (KernelIsa isa : {KernelIsa::Scalar, KernelIsa::SSE2, KernelIsa::AVX2}) {
+        if (isa > bestKernelIsa()) break;
+        string name = string("car_kernel_") + kernelIsaName(isa);
+        transform(name.begin(), name.end(), name.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+        cases.push_back({"pricing", name, count, prepareInputs(cars, costs), [cars, costs, isa] {
+            carRentalCosts(cars->days.data(), cars->doors.data(), 1, costs->data(), cars->days.size(), isa);
+            return static_cast<uint64_t>(totalCents(*costs));
+        }});
+    }
+}
+
+// Submissions spread at random over 16 multiple choice exams
+struct SubmissionInput {
+    vector<unique_ptr<MultipleChoiceExam>> exams;
+    vector<Submission> submissions;
+};
+
+// A cohort's answer sheets for one 200 question exam
+struct CohortInput {
+    unique_ptr<MultipleChoiceExam> exam;
+    unique_ptr<CohortAnswers> answers;
+};
+
+static void addGradingBenchmarks(vector<BenchmarkCase>& cases, const BenchmarkOptions& options) {
+    const size_t count = static_cast<size_t>(1000000 * options.scale);
+    const uint64_t seed = options.seed;
+    LazyInput<SubmissionInput> input([count, seed] {
+        auto input = make_unique<SubmissionInput>();
+        for (int i = 0; i < 16; i++) {
+            input->exams.push_back(make_unique<MultipleChoiceExam>("MC" + to_string(100 + i), "Mathematics", 60, 20 + 12 * i));
+        }
+        input->submissions.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            input->submissions[i] = {input->exams[splitmix64(seed + i) % input->exams.size()].get(), i};
+        }
+        return input;
+    });
+
+    // Single thread, one noexcept tryGrade per submission
+    cases.push_back({"grading", "multiple_choice_try_grade", count, prepareInputs(input), [input, seed] {
+        uint64_t total = 0;
+        for (size_t i = 0; i < input->submissions.size(); i++) {
+            Expected<ExamResult> result = input->submissions[i].exam->tryGrade(splitmix64(seed + i * 0x9E3779B97F4A7C15ull));
+            total += result ? result.value().score : 0;
+        }
+        return total;
+    }});
+
+    // All cores through the GradingEngine; gives the same scores as the loop above for the same seed
+    const unsigned engineThreads = thread::hardware_concurrency();
+    LazyInput<GradingEngine> engine([engineThreads] { return make_unique<GradingEngine>(engineThreads); });
+    cases.push_back({"grading", "multiple_choice_engine_" + to_string(engineThreads) + "_threads", count, prepareInputs(input, engine),
+                     [input, engine, seed] {
+        uint64_t total = 0;
+        for (const ExamResult& result : engine->gradeAll(input->submissions, seed)) {
+            total += result.score;
+        }
+        return total;
+    }});
+
+    // A whole cohort's answer sheets against one key, with per-question statistics
+    const size_t students = static_cast<size_t>(20000 * options.scale);
+    LazyInput<CohortInput> cohort([students, seed] {
+        const int questions = 200;
+        auto cohort = make_unique<CohortInput>();
+        cohort->exam = make_unique<MultipleChoiceExam>("MC900", "Physics", 120, questions);
+        cohort->answers = make_unique<CohortAnswers>(questions, students);
+        mt19937_64 rng(seed + 2);
+        for (size_t s = 0; s < students; s++) {
+            for (int q = 0; q < questions; q++) {
+                cohort->answers->setAnswer(s, q, static_cast<int>(rng() % 5) - 1);
+            }
+        }
+        return cohort;
+    });
+    cases.push_back({"grading", "multiple_choice_cohort", students, prepareInputs(cohort), [cohort] {
+        CohortReport report = cohort->exam->gradeCohort(*cohort->answers);
+        uint64_t total = 0;
+        for (int score : report.scores) total += score;
+        return total;
+    }});
+}
+
+// Ten exams, one with an invalid (zero) duration, and the order they are graded in
+struct ValidationInput {
+    vector<unique_ptr<MultipleChoiceExam>> exams;
+    vector<uint32_t> order;
+};
+
+static void addValidationBenchmarks(vector<BenchmarkCase>& cases, const BenchmarkOptions& options) {
+    const size_t count = static_cast<size_t>(1000000 * options.scale);
+    const uint64_t seed = options.seed;
+    LazyInput<ValidationInput> input([count, seed] {
+        auto input = make_unique<ValidationInput>();
+        for (int i = 0; i < 10; i++) {
+            input->exams.push_back(make_unique<MultipleChoiceExam>("MC" + to_string(200 + i), "Chemistry", i == 0 ? 0 : 60, 40));
+        }
+        input->order.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            input->order[i] = static_cast<uint32_t>(splitmix64(seed + i) % input->exams.size());
+        }
+        return input;
+    });
+
+    cases.push_back({"validation", "exceptions", count, prepareInputs(input), [input] {
+        uint64_t total = 0, failed = 0;
+        for (size_t i = 0; i < input->order.size(); i++) {
+            try {
+                total += input->exams[input->order[i]]->grade(i).score;
+            } catch (const InvalidExamDurationException&) {
+                failed++;
+            }
+        }
+        return total * 1000003 + failed;
+    }});
+
+    cases.push_back({"validation", "expected_noexcept", count, prepareInputs(input), [input] {
+        uint64_t total = 0, failed = 0;
+        for (size_t i = 0; i < input->order.size(); i++) {
+            Expected<ExamResult> result = input->exams[input->order[i]]->tryGrade(i);
+            if (result) total += result.value().score;
+            else failed++;
+        }
+        return total * 1000003 + failed;
+    }});
+}
+
+// Each round creates and destroys 10 million objects, as 10 generations of 1 million alive at once
+// (the arena is reset after every generation), the same measurement the programs' --bench modes used to make.
+static void addCreationBenchmarks(vector<BenchmarkCase>& cases, const BenchmarkOptions& options) {
+    const size_t generationSize = max<size_t>(static_cast<size_t>(1000000 * options.scale), 1);
+    const int generations = 10;
+    const size_t count = generationSize * generations;
+    LazyInput<vector<Vehicle*>> vehicles([generationSize] { return make_unique<vector<Vehicle*>>(generationSize); });
+    LazyInput<vector<Exam*>> exams([generationSize] { return make_unique<vector<Exam*>>(generationSize); });
+    LazyInput<MonotonicArena> arena([] { return make_unique<MonotonicArena>(4 << 20); });
+
+    // Vehicles with make and model strings too long for the small string buffer
+    cases.push_back({"creation", "vehicles_new_delete", count, prepareInputs(vehicles), [vehicles] {
+        uint64_t years = 0;
+        for (int generation = 0; generation < generations; generation++) {
+            for (size_t i = 0; i < vehicles->size(); i++) {
+                switch (i % 3) {
+                    case 0: (*vehicles)[i] = new Car("Toyota Motor Corporation", "Corolla Hybrid Estate", 2020, 4); break;
+                    case 1: (*vehicles)[i] = new SUV("Mitsubishi Motors Corporation", "Pajero Sport Exceed", 2021, 7); break;
+                    default: (*vehicles)[i] = new Truck("Isuzu Motors East Africa", "FVZ 1400 Tipper Chassis", 2019, 10000.0f); break;
+                }
+            }
+            for (Vehicle* vehicle : *vehicles) {
+                years += vehicle->year;
+                delete vehicle;
+            }
+        }
+        return years;
+    }});
+
+    cases.push_back({"creation", "vehicles_arena", count, prepareInputs(vehicles, arena), [vehicles, arena] {
+        MonotonicArena* slabs = &*arena;
+        uint64_t years = 0;
+        for (int generation = 0; generation < generations; generation++) {
+            for (size_t i = 0; i < vehicles->size(); i++) {
+                switch (i % 3) {
+                    case 0: (*vehicles)[i] = arena->makeNoDestructor<Car>("Toyota Motor Corporation", "Corolla Hybrid Estate", 2020, 4, slabs); break;
+                    case 1: (*vehicles)[i] = arena->makeNoDestructor<SUV>("Mitsubishi Motors Corporation", "Pajero Sport Exceed", 2021, 7, slabs); break;
+                    default: (*vehicles)[i] = arena->makeNoDestructor<Truck>("Isuzu Motors East Africa", "FVZ 1400 Tipper Chassis", 2019, 10000.0f, slabs); break;
+                }
+            }
+            for (Vehicle* vehicle : *vehicles) years += vehicle->year;
+            arena->reset();
+        }
+        return years;
+    }});
+
+    cases.push_back({"creation", "exams_new_delete", count, prepareInputs(exams), [exams] {
+        uint64_t minutes = 0;
+        for (int generation = 0; generation < generations; generation++) {
+            for (size_t i = 0; i < exams->size(); i++) {
+                if (i % 2 == 0) (*exams)[i] = new MultipleChoiceExam("MC101", "Mathematics", 60, 20);
+                else (*exams)[i] = new EssayExam("EE101", "Literature", 90, "Qunatum Computing Term Paper");
+            }
+            for (Exam* exam : *exams) {
+                minutes += exam->getDuration();
+                delete exam;
+            }
+        }
+        return minutes;
+    }});
+
+    cases.push_back({"creation", "exams_arena", count, prepareInputs(exams, arena), [exams, arena] {
+        MonotonicArena* slabs = &*arena;
+        uint64_t minutes = 0;
+        for (int generation = 0; generation < generations; generation++) {
+            for (size_t i = 0; i < exams->size(); i++) {
+                if (i % 2 == 0) (*exams)[i] = arena->makeNoDestructor<MultipleChoiceExam>("MC101", "Mathematics", 60, 20, slabs);
+                else (*exams)[i] = arena->makeNoDestructor<EssayExam>("EE101", "Literature", 90, "Qunatum Computing Term Paper", slabs);
+            }
+            for (Exam* exam : *exams) minutes += exam->getDuration();
+            arena->reset();
+        }
+        return minutes;
+    }});
+}
+
+// One priced booking and one graded result, as a history that a full recomputation has to scan
+struct BookingRecord {
+    VehicleType type;
+    int16_t year;
+    int32_t cents;
+};
+
+struct ScoreRecord {
+    uint32_t exam;
+    int16_t score;
+    int16_t outOf;
+};
+
+// Same rounding and nearest-rank rule as ScoreSketch, so both ways of answering give the same numbers
+static int percentOf(const ScoreRecord& record) {
+    return (record.score * 100 + record.outOf / 2) / record.outOf;
+}
+
+static uint64_t dashboardChecksum(long long cents, long long bookings) {
+    return static_cast<uint64_t>(cents) * 31 + static_cast<uint64_t>(bookings);
+}
+
+// 200 exams in 8 subjects and a history of results for them
+struct ScoreHistory {
+    vector<unique_ptr<MultipleChoiceExam>> exams;
+    vector<uint32_t> examSubject;
+    vector<ScoreRecord> scores;
+};
+
+// The dashboards: revenue per type and per model year, and mean/p50/p90 per subject and per exam.
+// Incremental aggregates are compared with recomputing the same figures from the whole history.
+static void addAggregateBenchmarks(vector<BenchmarkCase>& cases, const BenchmarkOptions& options) {
+    const size_t count = static_cast<size_t>(10000000 * options.scale);
+    const uint64_t seed = options.seed;
+    const int firstYear = 2000, lastYear = 2025;
+
+    LazyInput<vector<BookingRecord>> bookings([count, seed] {
+        auto bookings = make_unique<vector<BookingRecord>>(count);
+        mt19937_64 rng(seed + 3);
+        for (BookingRecord& booking : *bookings) {
+            booking.type = static_cast<VehicleType>(1 + rng() % 3);
+            booking.year = static_cast<int16_t>(firstYear + rng() % (lastYear - firstYear + 1));
+            booking.cents = static_cast<int32_t>(100000 + rng() % 10000000);
+        }
+        return bookings;
+    });
+
+    cases.push_back({"aggregates", "revenue_record", count, prepareInputs(bookings), [bookings] {
+        auto revenue = make_unique<FleetRevenue>();
+        for (const BookingRecord& booking : *bookings) {
+            revenue->record(booking.type, booking.year, booking.cents);
+        }
+        RevenueTotal total = revenue->overall();
+        return dashboardChecksum(total.cents, total.bookings);
+    }});
+
+    LazyInput<FleetRevenue> revenue([bookings] {
+        auto revenue = make_unique<FleetRevenue>();
+        for (const BookingRecord& booking : *bookings) {
+            revenue->record(booking.type, booking.year, booking.cents);
+        }
+        return revenue;
+    });
+    const VehicleType types[] = {VehicleType::Car, VehicleType::SUV, VehicleType::Truck};
+
+    // 1000 dashboard refreshes per round; the checksum is the same for every refresh
+    cases.push_back({"aggregates", "revenue_dashboard_incremental", 1000, prepareInputs(revenue), [revenue, types] {
+        uint64_t checksum = 0;
+        for (int refresh = 0; refresh < 1000; refresh++) {
+            checksum = 0;
+            for (VehicleType type : types) {
+                RevenueTotal total = revenue->forType(type);
+                checksum += dashboardChecksum(total.cents, total.bookings);
+            }
+            for (int year = firstYear; year <= lastYear; year++) {
+                RevenueTotal total = revenue->forYear(year);
+                checksum += dashboardChecksum(total.cents, total.bookings);
+            }
+        }
+        return checksum;
+    }});
+
+    cases.push_back({"aggregates", "revenue_dashboard_recompute", 1, prepareInputs(bookings), [bookings, types] {
+        vector<RevenueTotal> byType(4), byYear(lastYear - firstYear + 1);
+        for (const BookingRecord& booking : *bookings) {
+            RevenueTotal& type = byType[static_cast<int>(booking.type)];
+            RevenueTotal& year = byYear[booking.year - firstYear];
+            type.cents += booking.cents;
+            type.bookings++;
+            year.cents += booking.cents;
+            year.bookings++;
+        }
+        uint64_t checksum = 0;
+        for (VehicleType type : types) {
+            checksum += dashboardChecksum(byType[static_cast<int>(type)].cents, byType[static_cast<int>(type)].bookings);
+        }
+        for (const RevenueTotal& year : byYear) checksum += dashboardChecksum(year.cents, year.bookings);
+        return checksum;
+    }});
+
+    LazyInput<ScoreHistory> history([count, seed] {
+        const char* subjectNames[] = {"Mathematics", "Physics", "Chemistry", "Biology", "History", "Geography", "Literature", "Economics"};
+        auto history = make_unique<ScoreHistory>();
+        for (uint32_t i = 0; i < 200; i++) {
+            history->exams.push_back(make_unique<MultipleChoiceExam>("MC" + to_string(1000 + i), subjectNames[i % 8], 60, 20 + i % 40));
+            history->examSubject.push_back(i % 8);
+        }
+        history->scores.resize(count);
+        mt19937_64 rng(seed + 4);
+        for (ScoreRecord& record : history->scores) {
+            record.exam = static_cast<uint32_t>(rng() % history->exams.size());
+            record.outOf = static_cast<int16_t>(history->exams[record.exam]->getQuestions());
+            record.score = static_cast<int16_t>(rng() % (record.outOf + 1));
+        }
+        return history;
+    });
+
+    cases.push_back({"aggregates", "scores_record", count, prepareInputs(history), [history] {
+        auto aggregates = make_unique<ScoreAggregates>();
+        for (const ScoreRecord& record : history->scores) {
+            aggregates->record(*history->exams[record.exam], ExamResult{record.score, record.outOf, true});
+        }
+        return aggregates->subject("Mathematics")->count();
+    }});
+
+    // A writer that keeps each exam's sketches, as GradingEngine does, instead of looking them up by name every time
+    cases.push_back({"aggregates", "scores_record_cached_sketches", count, prepareInputs(history), [history] {
+        auto aggregates = make_unique<ScoreAggregates>();
+        vector<ScoreAggregates::Sketches> sketches;
+        for (const auto& exam : history->exams) sketches.push_back(aggregates->sketchesFor(*exam));
+        for (const ScoreRecord& record : history->scores) {
+            ExamResult result{record.score, record.outOf, true};
+            sketches[record.exam].subject->record(result);
+            sketches[record.exam].exam->record(result);
+        }
+        return aggregates->subject("Mathematics")->count();
+    }});
+
+    LazyInput<ScoreAggregates> aggregates([history] {
+        auto aggregates = make_unique<ScoreAggregates>();
+        for (const ScoreRecord& record : history->scores) {
+            aggregates->record(*history->exams[record.exam], ExamResult{record.score, record.outOf, true});
+        }
+        return aggregates;
+    });
+    auto summaryChecksum = [](double mean, int p50, int p90) {
+        return static_cast<uint64_t>(llround(mean * 100)) * 10007 + static_cast<uint64_t>(p50) * 101 + static_cast<uint64_t>(p90);
+    };
+
+    cases.push_back({"aggregates", "scores_dashboard_incremental", 100, prepareInputs(aggregates), [aggregates, summaryChecksum] {
+        uint64_t checksum = 0;
+        for (int refresh = 0; refresh < 100; refresh++) {
+            checksum = 0;
+            for (const string& name : aggregates->subjectNames()) {
+                const ScoreSketch* sketch = aggregates->subject(name);
+                checksum += summaryChecksum(sketch->mean(), sketch->percentile(0.5), sketch->percentile(0.9));
+            }
+            for (const string& examID : aggregates->examIDs()) {
+                const ScoreSketch* sketch = aggregates->exam(examID);
+                checksum += summaryChecksum(sketch->mean(), sketch->percentile(0.5), sketch->percentile(0.9));
+            }
+        }
+        return checksum;
+    }});
+
+    // Gathers every subject's and exam's percentages and selects the percentiles from them
+    cases.push_back({"aggregates", "scores_dashboard_recompute", 1, prepareInputs(history), [history, summaryChecksum] {
+        vector<vector<uint8_t>> bySubject(8), byExam(history->exams.size());
+        vector<uint64_t> subjectBasisPoints(8), examBasisPoints(history->exams.size());
+        for (const ScoreRecord& record : history->scores) {
+            uint8_t percent = static_cast<uint8_t>(percentOf(record));
+            uint64_t basisPoints = (uint64_t(record.score) * 10000 + record.outOf / 2) / record.outOf;
+            uint32_t subject = history->examSubject[record.exam];
+            bySubject[subject].push_back(percent);
+            byExam[record.exam].push_back(percent);
+            subjectBasisPoints[subject] += basisPoints;
+            examBasisPoints[record.exam] += basisPoints;
+        }
+        auto summarize = [&summaryChecksum](vector<uint8_t>& percents, uint64_t basisPoints) {
+            if (percents.empty()) return summaryChecksum(0.0, -1, -1);
+            auto nearestRank = [&percents](double p) {
+                size_t rank = max<size_t>(1, static_cast<size_t>(ceil(p * percents.size())));
+                nth_element(percents.begin(), percents.begin() + (rank - 1), percents.end());
+                return static_cast<int>(percents[rank - 1]);
+            };
+            double mean = basisPoints / 100.0 / percents.size();
+            int p50 = nearestRank(0.5);
+            int p90 = nearestRank(0.9);
+            return summaryChecksum(mean, p50, p90);
+        };
+        uint64_t checksum = 0;
+        for (size_t s = 0; s < bySubject.size(); s++) checksum += summarize(bySubject[s], subjectBasisPoints[s]);
+        for (size_t e = 0; e < byExam.size(); e++) checksum += summarize(byExam[e], examBasisPoints[e]);
+        return checksum;
+    }});
+}
+
+// Runs one benchmark and writes its CSV row
+// Returns false if the checksum changed between rounds (the work is not deterministic)
+static bool runCase(const BenchmarkCase& benchmark, const BenchmarkOptions& options, ostream& csv) {
+    benchmark.prepare();
+    for (int i = 0; i < options.warmup; i++) {
+        benchmark.run();
+    }
+    vector<double> nanosecondsPerItem;
+    uint64_t checksum = 0;
+    bool stable = true;
+    size_t allocations = 0;
+    for (int i = 0; i < options.repetitions; i++) {
+        size_t allocationsBefore = allocation_counter::count();
+        auto start = chrono::steady_clock::now();
+        uint64_t result = benchmark.run();
+        double seconds = secondsSince(start);
+        allocations += allocation_counter::count() - allocationsBefore;
+        nanosecondsPerItem.push_back(seconds * 1e9 / benchmark.items);
+        stable = stable && (i == 0 || result == checksum);
+        checksum = result;
+    }
+    sort(nanosecondsPerItem.begin(), nanosecondsPerItem.end());
+    double mean = 0;
+    for (double ns : nanosecondsPerItem) mean += ns / nanosecondsPerItem.size();
+    size_t middle = nanosecondsPerItem.size() / 2;
+    double median = nanosecondsPerItem.size() % 2 == 1 ? nanosecondsPerItem[middle]
+                                                        : (nanosecondsPerItem[middle - 1] + nanosecondsPerItem[middle]) / 2;
+
+    csv << benchmark.group << ',' << benchmark.name << ',' << benchmark.items << ',' << options.seed << ','
+        << options.warmup << ',' << options.repetitions << ',' << nanosecondsPerItem.front() << ',' << median << ','
+        << mean << ',' << nanosecondsPerItem.back() << ',' << 1e9 / median << ','
+        << double(allocations) / options.repetitions / benchmark.items << ',' << checksum << '\n' << flush;
+    return stable;
+}
+
+int main(int argc, char* argv[]) {
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; i++) {
+        string flag = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (flag == "--seed" && hasValue) options.seed = stoull(argv[++i]);
+        else if (flag == "--warmup" && hasValue) options.warmup = stoi(argv[++i]);
+        else if (flag == "--repetitions" && hasValue) options.repetitions = max(stoi(argv[++i]), 1);
+        else if (flag == "--scale" && hasValue) options.scale = stod(argv[++i]);
+        else if (flag == "--filter" && hasValue) options.filter = argv[++i];
+        else if (flag == "--output" && hasValue) options.output = argv[++i];
+        else if (flag == "--list") options.list = true;
+        else {
+            cerr << "Usage: " << argv[0] << " [--seed N] [--warmup N] [--repetitions N] [--scale X] [--filter text] [--output file.csv] [--list]\n";
+            return 2;
+        }
+    }
+
+    // Registering the benchmarks builds no inputs; each one is built when the first benchmark using it runs
+    vector<BenchmarkCase> cases;
+    addPricingBenchmarks(cases, options);
+    addGradingBenchmarks(cases, options);
+    addValidationBenchmarks(cases, options);
+    addCreationBenchmarks(cases, options);
+    addAggregateBenchmarks(cases, options);
+
+    if (options.list) {
+        for (const BenchmarkCase& benchmark : cases) cout << benchmark.group << '/' << benchmark.name << '\n';
+        return 0;
+    }
+
+    ofstream file;
+    if (!options.output.empty()) {
+        file.open(options.output);
+        if (!file) {
+            cerr << "Cannot create " << options.output << endl;
+            return 1;
+        }
+    }
+    ostream& csv = options.output.empty() ? cout : file;
+    csv << "group,benchmark,items,seed,warmup,repetitions,min_ns_per_item,median_ns_per_item,mean_ns_per_item,max_ns_per_item,"
+           "items_per_second,allocations_per_item,checksum\n";
+
+    int unstable = 0;
+    for (const BenchmarkCase& benchmark : cases) {
+        if (!options.filter.empty() && (benchmark.group + '/' + benchmark.name).find(options.filter) == string::npos) {
+            continue;
+        }
+        if (!runCase(benchmark, options, csv)) {
+            cerr << "Warning: " << benchmark.group << '/' << benchmark.name << " gave a different checksum in different rounds\n";
+            unstable++;
+        }
+    }
+    return unstable == 0 ? 0 : 1;
+}
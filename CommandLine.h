@@ -0,0 +1,26 @@
+/*
+Command line helpers shared by both assignment programs.
+
+parseCount reads a count argument such as the number of bookings or results to generate. Unlike stoul,
+it never throws and does not turn "-1" into a huge unsigned number, so main can print its usage instead.
+*/
+
+#ifndef COMMAND_LINE_H
+#define COMMAND_LINE_H
+
+#include <charconv>
+#include <cstring>
+#include <system_error>
+
+// Reads a whole number in 1..maxValue, or returns 0 if text is not one (e.g. "abc", "-1", "12x" or too big)
+inline long long parseCount(const char* text, long long maxValue) {
+    long long value = 0;
+    const char* end = text + std::strlen(text);
+    auto parsed = std::from_chars(text, end, value);
+    if (parsed.ec != std::errc() || parsed.ptr != end || value <= 0 || value > maxValue) {
+        return 0;
+    }
+    return value;
+}
+
+#endif
@@ -0,0 +1,448 @@
+/*
+Exam hierarchy, cohort marking, essay grading service, grading engine and exam store files (see Exams.h).
+*/
+
+#include "Exams.h"
+#include <iostream>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <charconv>
+
+using namespace std;
+
+// Hot path timers and counters (see Instrumentation.h)
+instrumentation::Counter validationFailures("validation.failed");
+static instrumentation::Timer multipleChoiceTimer("grading.multipleChoice");
+static instrumentation::Timer essayTimer("grading.essay");
+static instrumentation::Timer cohortTimer("grading.cohort");
+static instrumentation::Timer chunkTimer("grading.engineChunk");
+static instrumentation::Counter engineSubmissions("grading.engineSubmissions");
+static instrumentation::Timer essayGraderTimer("grading.essayGrader");
+static instrumentation::Counter essayScoresRejected("grading.essayScoresRejected");
+
+void Exam::getExamDetails() const {
+    cout << "Exam ID: " << examID << "\n"
+         << "Subject: " << subject << "\n"
+         << "Duration: " << duration << " minutes\n";
+}
+
+// Marks every sheet of a cohort: scores[s] = correct answers of student s, and for every question q,
+// correctCount[q] = students who got it right and correctScoreSum[q] = the sum of those students' scores.
+// On x86 GCC builds a popcnt version and picks it at runtime when the CPU has the instruction.
+// (Not under ThreadSanitizer, whose runtime is not ready yet when the version is picked at startup.)
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(__clang__) && !defined(__SANITIZE_THREAD__)
+__attribute__((target_clones("popcnt", "default")))
+#endif
+static void markCohort(const uint64_t* key, const uint64_t* sheets, size_t students, int blocks,
+                       int* scores, uint32_t* correctCount, uint64_t* correctScoreSum) {
+    for (size_t s = 0; s < students; s++) {
+        const uint64_t* sheet = sheets + s * 3 * blocks;
+        int score = 0;
+        for (int b = 0; b < blocks; b++) {
+            score += popcount(AnswerSheet::matches(key, sheet, b));
+        }
+        scores[s] = score;
+        for (int b = 0; b < blocks; b++) {
+            for (uint64_t right = AnswerSheet::matches(key, sheet, b); right != 0; right &= right - 1) {
+                int q = b * 64 + countr_zero(right);
+                correctCount[q]++;
+                correctScoreSum[q] += score;
+            }
+        }
+    }
+}
+
+CohortReport MultipleChoiceExam::gradeCohort(const CohortAnswers& cohort) const {
+    instrumentation::ScopedTimer timing(cohortTimer);
+    if (duration <= 0) {
+        throw InvalidExamDurationException();
+    }
+    if (cohort.questions() != questions) {
+        throw invalid_argument("gradeCohort: answer sheets do not match the number of questions");
+    }
+    const size_t students = cohort.students();
+    CohortReport report;
+    report.scores.resize(students);
+    vector<uint32_t> correctCount(questions, 0);
+    vector<uint64_t> correctScoreSum(questions, 0);
+    markCohort(answerKey.data(), cohort.data(), students, answerKey.blocks(), report.scores.data(), correctCount.data(), correctScoreSum.data());
+
+    double sum = 0, sumOfSquares = 0;
+    for (int score : report.scores) {
+        sum += score;
+        sumOfSquares += double(score) * score;
+    }
+    report.meanScore = students ? sum / students : 0;
+    report.scoreDeviation = students ? sqrt(max(sumOfSquares / students - report.meanScore * report.meanScore, 0.0)) : 0;
+
+    report.questions.resize(questions);
+    for (int q = 0; q < questions; q++) {
+        double p = students ? double(correctCount[q]) / students : 0;
+        double discrimination = 0;
+        if (p > 0 && p < 1 && report.scoreDeviation > 0) {
+            double meanWhenRight = double(correctScoreSum[q]) / correctCount[q];
+            discrimination = (meanWhenRight - report.meanScore) / report.scoreDeviation * sqrt(p / (1 - p));
+        }
+        report.questions[q] = {p, discrimination};
+    }
+    return report;
+}
+
+void MultipleChoiceExam::gradeExam() {
+    instrumentation::ScopedTimer timing(multipleChoiceTimer);
+    // In C++, the try-catch block is used for exception handling, which allows a program to detect and handle runtime errors gracefully instead of crashing.        
+    // try block → Contains the code that might throw an exception.
+    // catch block → Catches and handles the exception.
+    try {
+        // Check if the exam duration is valid, throw an exception if invalid
+        // If duration is negative or zero, it is considered invalid.
+        if (duration <= 0) {
+            // If the condition is met, the program throws an instance of the InvalidExamDurationException class.
+            // This means the program stops executing the function immediately and transfers control to the nearest catch block that can handle this exception.
+            throw InvalidExamDurationException();
+        }
+
+        // Simulate grading by generating a random score between 0 and the number of questions
+        // Zero being the lower limit and number of questions being the upper limit of the random number
+        // The random bits come from this thread's own engine, seeded once. Calling srand(time(0)) on every
+        // call was not thread-safe and gave two exams graded in the same second the same score.
+        ExamResult result = grade(threadRandomEngine()());
+
+        cout << "Grading Multiple Choice Exam..." << endl;
+        cout << "Score: " << result.score << "/" << result.outOf << " correct answers" << endl;
+    } catch (const exception& e) {
+        // Catch and display any exceptions that occur during grading
+        cout << e.what() << endl;
+    }
+}
+
+void EssayExam::gradeExam() {
+    instrumentation::ScopedTimer timing(essayTimer);       // Includes the wait for the grader
+    // In C++, the try-catch block is used for exception handling, which allows a program to detect and handle runtime errors gracefully instead of crashing.
+    // try block → Contains the code that might throw an exception.
+    // catch block → Catches and handles the exception.
+    try {
+        // Check if the exam duration is valid, throw an exception if invalid
+        // If duration is negative or zero, it is considered invalid.
+        if (duration <= 0) {
+            // If the condition is met, the program throws an instance of the InvalidExamDurationException class.
+            // This means the program stops executing the function immediately and transfers control to the nearest catch block that can handle this exception.
+            throw InvalidExamDurationException();
+        }
+
+        // Simulate grading by asking the grader to enter a score
+        // Lecturer enters the score but in multiple choice, the system calculates how many questions the student got right
+        // The prompt and cin run on the grading desk's grader thread, not inside this call; here we only wait for the answer.
+        // If the score is out of the valid range, valueOrThrow() throws a grading error exception
+        ExamResult result = valueOrThrow(askConsoleGrader(*this));
+
+        cout << "Grading Essay Exam..." << endl;
+        cout << "Score: " << result.score << "/" << result.outOf << endl;
+    } catch (const exception& e) {
+        // Catch and display any exceptions that occur during grading
+        cout << e.what() << endl;
+    }
+}
+
+void EssayGradingService::gradeLoop(GraderLog& log) {
+    Job job;
+    int idleRounds = 0;     // Capped at 128, so it never overflows however long the service is idle
+    while (true) {
+        if (!queue.tryPop(job)) {
+            if (stopping.load(memory_order_acquire) && queue.size() == 0) return;
+            // Back off while idle: spin a little, then yield, then sleep until submit() or the destructor wakes us
+            if (idleRounds < 128) {
+                if (++idleRounds >= 64) this_thread::yield();
+                continue;
+            }
+            unique_lock<mutex> lock(parkLock);
+            sleepingGraders.fetch_add(1, memory_order_relaxed);
+            atomic_thread_fence(memory_order_seq_cst);
+            workReady.wait(lock, [this] { return queue.size() > 0 || stopping.load(memory_order_acquire); });
+            sleepingGraders.fetch_sub(1, memory_order_relaxed);
+            continue;
+        }
+        idleRounds = 0;
+        int score;
+        {
+            instrumentation::ScopedTimer timing(essayGraderTimer);
+            score = grader(job.submission);
+        }
+        Expected<ExamResult> result = job.submission.exam->tryGrade(score);
+        if (!result) essayScoresRejected.add();
+        auto latency = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - job.submittedAt).count();
+        job.done(result);
+        {
+            lock_guard<mutex> lock(log.lock);
+            log.latencies.record(static_cast<uint64_t>(latency));
+        }
+        completedCount.fetch_add(1, memory_order_release);
+    }
+}
+
+EssayQueueMetrics EssayGradingService::metrics() {
+    EssayQueueMetrics result;
+    result.submitted = submittedCount.load();
+    result.completed = completedCount.load();
+    result.rejected = rejectedCount.load();
+    result.maxDepth = maxDepth.load();
+    result.meanDepth = result.submitted ? double(depthTotal.load()) / result.submitted : 0;
+    instrumentation::LatencyHistogram latencies;
+    for (auto& log : logs) {
+        lock_guard<mutex> lock(log->lock);
+        latencies.merge(log->latencies);
+    }
+    result.latencyP50 = latencies.percentile(0.5) / 1e9;
+    result.latencyP99 = latencies.percentile(0.99) / 1e9;
+    result.latencyMax = latencies.max() / 1e9;
+    return result;
+}
+
+// Essay submission through a grading service, the result arrives through the returned future
+future<Expected<ExamResult>> submitForGrading(const EssayExam& exam, uint64_t studentId, EssayGradingService& service) {
+    return service.submit(EssaySubmission{&exam, studentId});
+}
+
+// Grader that types the score in at the console
+int consoleGrader(const EssaySubmission&) {
+    int score = -1;
+    cout << "Enter score for the Essay Exam (0-100): ";
+    cin >> score;
+    return score;
+}
+
+Expected<ExamResult> askConsoleGrader(const EssayExam& exam) {
+    static EssayGradingService consoleDesk(16, 1, consoleGrader);   // One person at the console
+    return submitForGrading(exam, 0, consoleDesk).get();
+}
+
+ScriptedGrader::ScriptedGrader(const string& path) : scores(make_shared<vector<int>>()), next(make_shared<atomic<size_t>>(0)) {
+    MappedFile file(path);
+    const char* cursor = file.data();
+    const char* end = cursor + file.size();
+    while (cursor < end) {
+        int score;
+        auto parsed = from_chars(cursor, end, score);
+        if (parsed.ec == errc()) {
+            scores->push_back(score);
+            cursor = parsed.ptr;
+        } else {
+            cursor++;   // Skip separators and anything that is not a number
+        }
+    }
+    if (scores->empty()) {
+        throw runtime_error("No scores in " + path);
+    }
+}
+
+ScoreAggregates::Sketches ScoreAggregates::sketchesFor(const Exam& exam) {
+    {
+        shared_lock<shared_mutex> lock(keysLock);
+        auto found = exams.find(exam.getExamID());
+        if (found != exams.end()) {
+            return {found->second.subject, found->second.sketch.get()};
+        }
+    }
+    // First result for this exam: add its sketch, and its subject's if that is new too
+    unique_lock<shared_mutex> lock(keysLock);
+    auto& subject = subjects[string(exam.getSubject())];
+    if (!subject) subject = make_unique<ScoreSketch>();
+    ExamEntry& entry = exams[string(exam.getExamID())];
+    if (!entry.sketch) entry = {make_unique<ScoreSketch>(), subject.get()};
+    return {entry.subject, entry.sketch.get()};
+}
+
+vector<string> ScoreAggregates::subjectNames() const {
+    shared_lock<shared_mutex> lock(keysLock);
+    vector<string> names;
+    for (const auto& entry : subjects) names.push_back(entry.first);
+    sort(names.begin(), names.end());
+    return names;
+}
+
+vector<string> ScoreAggregates::examIDs() const {
+    shared_lock<shared_mutex> lock(keysLock);
+    vector<string> names;
+    for (const auto& entry : exams) names.push_back(entry.first);
+    sort(names.begin(), names.end());
+    return names;
+}
+
+// Adds one graded chunk to the score summaries
+// Each exam's results are tallied privately first and merged into the shared sketches at the end,
+// so the chunk costs a few atomic adds per exam instead of four per result.
+static void recordChunk(ScoreAggregates& totals, const vector<Submission>& submissions, const vector<ExamResult>& results, size_t begin, size_t end) {
+    struct Slot {
+        const MultipleChoiceExam* exam;
+        ScoreAggregates::Sketches sketches;
+        ScoreTally tally;
+    };
+    // Open addressing by exam address, with linear probing. If a chunk has more distinct exams than
+    // fit at half load, every tally is merged and the table starts again.
+    const size_t slotCount = 256, maxExams = slotCount / 2;
+    auto slots = make_unique_for_overwrite<Slot[]>(slotCount);
+    auto clear = [&slots, slotCount] {
+        for (size_t s = 0; s < slotCount; s++) slots[s].exam = nullptr;
+    };
+    auto flushAll = [&slots, slotCount] {
+        for (size_t s = 0; s < slotCount; s++) {
+            if (slots[s].exam != nullptr) {
+                slots[s].sketches.subject->merge(slots[s].tally);
+                slots[s].sketches.exam->merge(slots[s].tally);
+            }
+        }
+    };
+    clear();
+    size_t examsInTable = 0;
+    for (size_t i = begin; i < end; i++) {
+        const MultipleChoiceExam* exam = submissions[i].exam;
+        size_t s = splitmix64(reinterpret_cast<uintptr_t>(exam)) % slotCount;
+        while (slots[s].exam != nullptr && slots[s].exam != exam) s = (s + 1) % slotCount;
+        if (slots[s].exam == nullptr) {
+            if (examsInTable == maxExams) {
+                flushAll();
+                clear();
+                examsInTable = 0;
+                s = splitmix64(reinterpret_cast<uintptr_t>(exam)) % slotCount;
+            }
+            slots[s].exam = exam;
+            slots[s].sketches = totals.sketchesFor(*exam);
+            slots[s].tally = {};
+            examsInTable++;
+        }
+        slots[s].tally.record(results[i]);
+    }
+    flushAll();
+}
+
+vector<ExamResult> GradingEngine::gradeAll(const vector<Submission>& submissions, uint64_t seed, size_t chunkSize) {
+    vector<ExamResult> results(submissions.size());
+    chunkSize = max<size_t>(chunkSize, 1);     // A chunk of 0 would never move on to the next submission
+    for (size_t begin = 0; begin < submissions.size(); begin += chunkSize) {
+        size_t end = begin + min(chunkSize, submissions.size() - begin);
+        pool.submit([&submissions, &results, seed, begin, end, totals = scores] {
+            instrumentation::ScopedTimer timing(chunkTimer);
+            engineSubmissions.add(end - begin);
+            for (size_t i = begin; i < end; i++) {
+                Expected<ExamResult> outcome = submissions[i].exam->tryGrade(splitmix64(seed + i * 0x9E3779B97F4A7C15ull));
+                results[i] = outcome ? outcome.value() : ExamResult{};  // Not graded
+            }
+            if (totals != nullptr) {
+                recordChunk(*totals, submissions, results, begin, end);
+            }
+        });
+    }
+    pool.wait();
+    return results;
+}
+
+void ExamStoreWriter::save(const string& path) {
+    stable_sort(results.begin(), results.end(), [](const ResultRecord& a, const ResultRecord& b) {
+        return a.examIndex != b.examIndex ? a.examIndex < b.examIndex : a.studentId < b.studentId;
+    });
+
+    StoreHeader header = {};
+    memcpy(header.magic, examStoreMagic, sizeof(examStoreMagic));
+    header.version = examStoreVersion;
+    header.headerSize = sizeof(StoreHeader);
+    header.examCount = exams.size();
+    header.keyWordCount = keyWords.size();
+    header.resultCount = results.size();
+    header.stringBytes = strings.size();
+    // Every record size is a multiple of 8, so the sections follow each other without padding except after the strings
+    header.examOffset = sizeof(StoreHeader);
+    header.keyOffset = header.examOffset + exams.size() * sizeof(ExamRecord);
+    header.resultOffset = header.keyOffset + keyWords.size() * sizeof(uint64_t);
+    header.stringOffset = header.resultOffset + results.size() * sizeof(ResultRecord);
+
+    BufferedWriter writer(path, 4 << 20);
+    writer.write(string_view(reinterpret_cast<const char*>(&header), sizeof(header)));
+    writeRecords(writer, exams);
+    writeRecords(writer, keyWords);
+    writeRecords(writer, results);
+    writer.write(strings);
+    align(writer);
+    writer.flush();
+}
+
+ExamStoreReader::ExamStoreReader(const string& path) : file(path) {
+    if (file.size() < sizeof(StoreHeader) || memcmp(file.data(), examStoreMagic, sizeof(examStoreMagic)) != 0) {
+        throw runtime_error(path + " is not an exam store file");
+    }
+    memcpy(&header, file.data(), sizeof(header));
+    if (header.version > examStoreVersion) {
+        throw runtime_error(path + " was written by a newer version (" + to_string(header.version) + ")");
+    }
+    if (header.headerSize < sizeof(StoreHeader) || !sectionFits(header.examOffset, header.examCount, sizeof(ExamRecord))
+        || !sectionFits(header.keyOffset, header.keyWordCount, sizeof(uint64_t)) || !sectionFits(header.resultOffset, header.resultCount, sizeof(ResultRecord))
+        || header.stringOffset > file.size() || header.stringBytes > file.size() - header.stringOffset) {
+        throw runtime_error(path + " is damaged: a section runs past the end of the file");
+    }
+    // Every record is checked now, so a damaged file is refused here instead of giving wrong answers later:
+    // exams are indexed by ID, and results must point at an exam and be sorted the way resultRange searches them
+    for (size_t i = 0; i < header.examCount; i++) {
+        ExamRecord exam = record<ExamRecord>(header.examOffset, i);
+        for (StringRef ref : {exam.id, exam.subject, exam.topic}) {
+            if (uint64_t(ref.offset) + ref.length > header.stringBytes) {
+                throw runtime_error(path + " is damaged: a string runs past the string table");
+            }
+        }
+        bool multipleChoice = exam.kind == static_cast<uint8_t>(StoredExamKind::MultipleChoice);
+        if ((!multipleChoice && exam.kind != static_cast<uint8_t>(StoredExamKind::Essay)) || exam.questions < 0
+            || (multipleChoice && uint64_t(exam.keyWord) + 3 * AnswerSheet::blocksFor(exam.questions) > header.keyWordCount)) {
+            throw runtime_error(path + " is damaged: bad exam record");
+        }
+        examsById.emplace(text(exam.id), i);
+    }
+    ResultRecord previous{0, 0, 0, 0};
+    for (size_t i = 0; i < header.resultCount; i++) {
+        ResultRecord stored = record<ResultRecord>(header.resultOffset, i);
+        if (stored.examIndex >= header.examCount || stored.score > stored.outOf) {
+            throw runtime_error(path + " is damaged: bad result record " + to_string(i));
+        }
+        if (i > 0 && (stored.examIndex < previous.examIndex || (stored.examIndex == previous.examIndex && stored.studentId < previous.studentId))) {
+            throw runtime_error(path + " is damaged: results are not sorted by exam and student");
+        }
+        previous = stored;
+    }
+}
+
+unique_ptr<Exam> ExamStoreReader::restoreExam(size_t index, pmr::memory_resource* memory) const {
+    checkIndex(index, header.examCount, "exam");
+    ExamRecord stored = record<ExamRecord>(header.examOffset, index);
+    if (stored.kind == static_cast<uint8_t>(StoredExamKind::Essay)) {
+        return make_unique<EssayExam>(text(stored.id), text(stored.subject), stored.duration, text(stored.topic), memory);
+    }
+    AnswerSheet key(stored.questions, file.data() + header.keyOffset + stored.keyWord * sizeof(uint64_t), memory);
+    return make_unique<MultipleChoiceExam>(text(stored.id), text(stored.subject), stored.duration, key, memory);
+}
+
+pair<size_t, size_t> ExamStoreReader::resultRange(uint32_t examIndex) const {
+    auto firstNotBefore = [&](uint32_t exam) {
+        size_t low = 0, high = resultCount();
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            if (record<ResultRecord>(header.resultOffset, middle).examIndex < exam) low = middle + 1;
+            else high = middle;
+        }
+        return low;
+    };
+    return {firstNotBefore(examIndex), examIndex == UINT32_MAX ? resultCount() : firstNotBefore(examIndex + 1)};
+}
+
+optional<ExamResult> ExamStoreReader::findResult(uint32_t examIndex, uint64_t studentId) const {
+    auto [first, last] = resultRange(examIndex);
+    size_t low = first, high = last;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (record<ResultRecord>(header.resultOffset, middle).studentId < studentId) low = middle + 1;
+        else high = middle;
+    }
+    if (low < last) {
+        StoredResult found = result(low);
+        if (found.studentId == studentId) return found.result;
+    }
+    return nullopt;
+}
@@ -0,0 +1,1139 @@
+/*
+Exam hierarchy of the online exam program (question 2), with everything built on it:
+bit-packed answer sheets and cohort marking, the noexcept grading API, the asynchronous essay
+grading service, the parallel grading engine, and the exam store file format.
+*/
+
+#ifndef EXAMS_H
+#define EXAMS_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Arena.h"
+#include "FileIO.h"
+#include "Instrumentation.h"
+#include "StringMap.h"
+
+// splitmix64: turns a 64 bit counter into 64 well mixed random bits
+// Used as a counter-based random number generator: the bits for submission i depend only on (seed, i),
+// never on which thread grades it or in what order, so parallel grading is reproducible.
+inline uint64_t splitmix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// Random engine for the calling thread, seeded once per thread
+// rand() shares one hidden state between all threads, which is not thread-safe.
+inline std::mt19937_64& threadRandomEngine() {
+    thread_local std::mt19937_64 engine(std::random_device{}());
+    return engine;
+}
+
+// Result of grading one exam, returned as a value instead of printed
+struct ExamResult {
+    int score = 0;
+    int outOf = 0;
+    bool graded = false;    // False if the exam could not be graded (e.g. invalid duration)
+};
+
+// Why an exam could not be graded
+// The noexcept grading functions return one of these instead of throwing, because in bulk grading bad
+// records are common and unwinding an exception for each one costs far more than grading it.
+enum class GradeError {
+    None,
+    InvalidDuration,    // Duration is zero or negative (InvalidExamDurationException)
+    ScoreOutOfRange,    // Essay score outside 0-100 (GradingErrorException)
+    SheetMismatch,      // Answer sheet has a different number of questions than the key (GradingErrorException)
+    QueueFull,          // The essay grading queue had no room, submit again later
+};
+
+// Either a result or the GradeError that prevented it, like C++23's std::expected
+template<typename T>
+class Expected {
+private:
+    T result{};
+    GradeError failure = GradeError::None;
+
+public:
+    Expected(const T& value) noexcept : result(value) {}
+    Expected(GradeError error) noexcept : failure(error) {}
+
+    bool ok() const noexcept { return failure == GradeError::None; }
+    explicit operator bool() const noexcept { return ok(); }
+    const T& value() const noexcept { return result; }     // Only meaningful when ok()
+    GradeError error() const noexcept { return failure; }
+};
+
+// A multiple choice answer sheet (or answer key), packed into bits
+// Options A-D are stored as 2 bit numbers 0-3 split over two bit planes, plus a third plane saying which
+// questions were answered at all. Each block of 64 questions is three 64 bit words: low bits, high bits, answered.
+// Marking a sheet against the key is then a few XOR/OR/AND operations and one popcount per 64 questions.
+class AnswerSheet {
+private:
+    int questionCount;
+    std::pmr::vector<uint64_t> words;
+
+public:
+    static constexpr int blank = -1;    // Option value of an unanswered question
+
+    static int blocksFor(int questions) { return (questions + 63) / 64; }
+
+    // Writes one answer into a packed sheet (option 0-3 for A-D, or blank)
+    static void setPacked(uint64_t* sheet, int question, int option) {
+        uint64_t* block = sheet + 3 * (question / 64);
+        uint64_t bit = uint64_t(1) << (question % 64);
+        block[0] = (option & 1) && option != blank ? block[0] | bit : block[0] & ~bit;
+        block[1] = (option & 2) && option != blank ? block[1] | bit : block[1] & ~bit;
+        block[2] = option != blank ? block[2] | bit : block[2] & ~bit;
+    }
+
+    // Questions of block b answered the same on sheet as on key (blank answers never match)
+    static uint64_t matches(const uint64_t* key, const uint64_t* sheet, int b) {
+        const uint64_t* k = key + 3 * b;
+        const uint64_t* a = sheet + 3 * b;
+        return k[2] & a[2] & ~((k[0] ^ a[0]) | (k[1] ^ a[1]));
+    }
+
+    explicit AnswerSheet(int questions, std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+        : questionCount(std::max(questions, 0)), words(3 * blocksFor(std::max(questions, 0)), 0, memory) {}
+
+    // Copy of other whose words are allocated from memory
+    AnswerSheet(const AnswerSheet& other, std::pmr::memory_resource* memory)
+        : questionCount(other.questionCount), words(other.words, memory) {}
+
+    AnswerSheet(const AnswerSheet&) = default;
+
+    // Sheet whose words are copied from packedBytes, which hold 3 * blocksFor(questions) words in this layout (e.g. read from a file)
+    AnswerSheet(int questions, const char* packedBytes, std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+        : AnswerSheet(questions, memory) {
+        std::memcpy(words.data(), packedBytes, words.size() * sizeof(uint64_t));
+    }
+
+    int questions() const { return questionCount; }
+    int blocks() const { return blocksFor(questionCount); }
+    const uint64_t* data() const { return words.data(); }
+
+    void setAnswer(int question, int option) {
+        if (question < 0 || question >= questionCount || option < blank || option > 3) {
+            throw std::out_of_range("AnswerSheet::setAnswer: no such question or option");
+        }
+        setPacked(words.data(), question, option);
+    }
+
+    int answer(int question) const {
+        const uint64_t* block = words.data() + 3 * (question / 64);
+        int shift = question % 64;
+        if (((block[2] >> shift) & 1) == 0) return blank;
+        return static_cast<int>(((block[0] >> shift) & 1) | (((block[1] >> shift) & 1) << 1));
+    }
+
+    // Number of questions answered the same as on the key
+    int countMatches(const AnswerSheet& key) const {
+        int correct = 0;
+        for (int b = 0; b < std::min(blocks(), key.blocks()); b++) {
+            correct += std::popcount(matches(key.data(), words.data(), b));
+        }
+        return correct;
+    }
+};
+
+// Answer sheets for a whole cohort of students, one after the other in one contiguous array
+// Each student's sheet has the AnswerSheet layout, so the cohort can be marked in a single pass.
+class CohortAnswers {
+private:
+    int questionCount;
+    size_t studentCount;
+    std::vector<uint64_t> words;
+
+public:
+    CohortAnswers(int questions, size_t students)
+        : questionCount(questions), studentCount(students), words(students * 3 * AnswerSheet::blocksFor(questions), 0) {}
+
+    int questions() const { return questionCount; }
+    size_t students() const { return studentCount; }
+    const uint64_t* data() const { return words.data(); }
+
+    void setAnswer(size_t student, int question, int option) {
+        if (student >= studentCount || question < 0 || question >= questionCount || option < AnswerSheet::blank || option > 3) {
+            throw std::out_of_range("CohortAnswers::setAnswer: no such student, question or option");
+        }
+        AnswerSheet::setPacked(words.data() + student * 3 * AnswerSheet::blocksFor(questionCount), question, option);
+    }
+};
+
+// Difficulty and discrimination of one question over a cohort
+struct QuestionStatistics {
+    double difficulty;      // Fraction of students who got it right (the classical "p value")
+    double discrimination;  // Point-biserial correlation between getting it right and the total score
+};
+
+struct CohortReport {
+    std::vector<int> scores;                     // scores[s] is student s's number of correct answers
+    std::vector<QuestionStatistics> questions;
+    double meanScore = 0;
+    double scoreDeviation = 0;              // Standard deviation of the scores
+};
+
+// Counted by Exam::validate (defined in Exams.cpp with the other timers and counters)
+extern instrumentation::Counter validationFailures;
+
+// Abstract base class for Exam
+class Exam {
+protected:
+    // pmr strings, so the characters can live in an arena together with the exam (see Arena.h)
+    std::pmr::string examID; // ID for the exam
+    std::pmr::string subject; // Subject of the exam
+    int duration; // Duration of the exam in minutes
+
+public:
+    // Constructor for Exam class to initialize ID, subject, and duration
+    // Cnstructor takes in arg and we can overide the values in the child/derived/sub class
+    // The strings are allocated from memory: the normal heap unless an arena is passed in
+    Exam(std::string_view id, std::string_view sub, int dur, std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+        : examID(memory), subject(memory) {
+        // this is a key word used to reference the variables with a local scope
+        // We equate them to the arguments the function/constructor brings
+         this->examID = id;
+         this->subject = sub; 
+         this->duration = dur;
+        }
+
+    // The constructor uses a member initializer list (: examID(id), subject(sub), duration(dur)) to directly initialize the member variables before entering the body.
+    // This is more efficient, especially for objects like std::string, because it avoids default construction followed by assignment.
+    // Exam(string id, string sub, int dur) : examID(id), subject(sub), duration(dur) {}
+
+    // Pure virtual function for grading exams that must be implemented in derived classes
+    // By overiding we change the functionality of the virtual class
+    // Any class containing this function must be abstract, and any derived class must override this function to be instantiated.
+    virtual void gradeExam() = 0;
+
+    // Checks the exam can be graded at all, without throwing
+    // A single comparison, so failures are counted rather than timed
+    GradeError validate() const noexcept {
+        if (duration <= 0) {
+            validationFailures.add();
+            return GradeError::InvalidDuration;
+        }
+        return GradeError::None;
+    }
+
+    // Virtual destructor for the Exam class to allow proper cleanup of derived class objects
+    virtual ~Exam() {}
+
+    std::string_view getExamID() const { return examID; }
+    std::string_view getSubject() const { return subject; }
+    int getDuration() const { return duration; }
+
+    // Getter function to display the details of the exam (ID, subject, and duration)
+    // Getters help us retrieve the data stored in private variables without directly calling the private variable
+    void getExamDetails() const;
+};
+
+// Custom Exception Class for invalid exam duration
+// This C++ code defines a custom exception class named InvalidExamDurationException, which is used to handle invalid exam durations.
+// It inherits from the standard std::exception class and overrides the what() function to provide a custom error message.
+class InvalidExamDurationException : public std::exception {
+public:
+    // Override what() function to provide a custom error message when the exception is thrown
+    const char* what() const noexcept override {
+        return "Error: Invalid exam duration!";
+    }
+};
+
+// Custom Exception Class for grading errors
+class GradingErrorException : public std::exception {
+public:
+    // Override what() function to provide a custom error message when the exception is thrown
+    const char* what() const noexcept override {
+        return "Error: Grading process failed!";
+    }
+};
+
+// Thin wrapper for callers that prefer exceptions: turns a GradeError into the matching exception class
+[[noreturn]] inline void throwGradeError(GradeError error) {
+    if (error == GradeError::InvalidDuration) {
+        throw InvalidExamDurationException();
+    }
+    throw GradingErrorException();
+}
+
+// Unwraps an Expected result, throwing the matching exception if grading failed
+inline ExamResult valueOrThrow(const Expected<ExamResult>& outcome) {
+    if (!outcome) {
+        throwGradeError(outcome.error());
+    }
+    return outcome.value();
+}
+
+// Derived class for MultipleChoiceExam that inherits from base/parent/super class Exam
+class MultipleChoiceExam : public Exam {
+private:
+    int questions; // Number of questions in the multiple choice exam
+    AnswerSheet answerKey; // The correct option for every question
+
+public:
+    // Constructor for MultipleChoiceExam, which calls the base class constructor
+    // and initializes the number of questions
+    // Without a key of its own the exam gets a made-up one, the same every time for the same exam ID
+    MultipleChoiceExam(std::string_view id, std::string_view sub, int dur, int q, std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+        : Exam(id, sub, dur, memory), questions(q), answerKey(q, memory) {
+        uint64_t idHash = 14695981039346656037ull;    // FNV-1a hash of the exam ID
+        for (char c : id) {
+            idHash = (idHash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+        }
+        for (int question = 0; question < questions; question++) {
+            answerKey.setAnswer(question, static_cast<int>(splitmix64(idHash + question) & 3));
+        }
+    }
+
+    // Constructor for an exam with a real answer key, one question per key entry
+    MultipleChoiceExam(std::string_view id, std::string_view sub, int dur, const AnswerSheet& key, std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+        : Exam(id, sub, dur, memory), questions(key.questions()), answerKey(key, memory) {}
+
+    int getQuestions() const { return questions; }
+    const AnswerSheet& getAnswerKey() const { return answerKey; }
+
+    // Grades a student's answer sheet against the key, without throwing
+    Expected<ExamResult> tryGrade(const AnswerSheet& sheet) const noexcept {
+        if (GradeError error = validate(); error != GradeError::None) {
+            return error;
+        }
+        if (sheet.questions() != questions) {
+            return GradeError::SheetMismatch;     // Like gradeCohort, a sheet for a different exam is not marked
+        }
+        return ExamResult{sheet.countMatches(answerKey), questions, true};
+    }
+
+    // Simulates grading one submission, without throwing
+    // The student's answers are drawn from randomBits (without building a sheet), so the same bits always give the same score.
+    Expected<ExamResult> tryGrade(uint64_t randomBits) const noexcept {
+        if (GradeError error = validate(); error != GradeError::None) {
+            return error;
+        }
+        int correct = 0;
+        for (int b = 0; b < answerKey.blocks(); b++) {
+            uint64_t guess[3] = {splitmix64(randomBits + 2 * b), splitmix64(randomBits + 2 * b + 1), ~uint64_t(0)};
+            correct += std::popcount(AnswerSheet::matches(answerKey.data() + 3 * b, guess, 0));
+        }
+        return ExamResult{correct, questions, true};
+    }
+
+    // Same as tryGrade, but throws InvalidExamDurationException when the duration is zero or negative,
+    // and GradingErrorException when the sheet does not have the key's number of questions
+    ExamResult grade(const AnswerSheet& sheet) const { return valueOrThrow(tryGrade(sheet)); }
+    ExamResult grade(uint64_t randomBits) const { return valueOrThrow(tryGrade(randomBits)); }
+
+    // Marks a whole cohort's answer sheets in one pass, with per-question statistics
+    // Throws InvalidExamDurationException for an invalid duration and invalid_argument if the sheets are for a different number of questions.
+    CohortReport gradeCohort(const CohortAnswers& cohort) const;
+
+    // Override the gradeExam function to implement grading logic for MultipleChoiceExam
+    void gradeExam() override;
+
+    // Destructor for MultipleChoiceExam (empty, as no resources are dynamically allocated)
+    ~MultipleChoiceExam() {}
+};
+
+class EssayExam;
+
+// Hands an essay to the console grading desk (see EssayGradingService) and waits for the score
+Expected<ExamResult> askConsoleGrader(const EssayExam& exam);
+
+// Derived class for EssayExam that inherits from Exam
+class EssayExam : public Exam {
+private:
+    std::pmr::string topic; // The essay topic
+
+public:
+    // Constructor for EssayExam, which calls the base class constructor
+    // and initializes the essay topic
+    // EssayExam is the constructor for this class
+    // The Exam(id, sub, dur) part calls the base class constructor (from the Exam class).
+    // The topic(t) part initializes the private topic member of EssayExam.
+    EssayExam(std::string_view id, std::string_view sub, int dur, std::string_view t, std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+        : Exam(id, sub, dur, memory), topic(t, memory) {}
+
+
+    // In the alternative below, the member topic is now initialized inside the constructor body instead of using : topic(t).
+    // EssayExam(string id, string sub, int dur, string t) : Exam(id, sub, dur) {
+    //     this->topic = t;
+    // }
+
+    // Records the score a grader gave, without throwing
+    // The score must be 0-100 and the exam's duration must be valid.
+    Expected<ExamResult> tryGrade(int score) const noexcept {
+        if (GradeError error = validate(); error != GradeError::None) {
+            return error;
+        }
+        if (score < 0 || score > 100) {
+            return GradeError::ScoreOutOfRange;
+        }
+        return ExamResult{score, 100, true};
+    }
+
+    // Same as tryGrade, but throws InvalidExamDurationException or GradingErrorException
+    ExamResult grade(int score) const { return valueOrThrow(tryGrade(score)); }
+
+    std::string_view getTopic() const { return topic; }
+
+    // Override the gradeExam function to implement grading logic for EssayExam
+    void gradeExam() override;
+
+    // Destructor for EssayExam (empty, as no resources are dynamically allocated)
+    ~EssayExam() {}
+};
+
+// Bounded queue that many threads can push to and pop from at once, without locks
+// Each cell carries a sequence number saying whether it is ready to be written or read for the current lap
+// around the ring (Dmitry Vyukov's bounded MPMC queue). A full queue refuses the push instead of waiting.
+template<typename T>
+class BoundedQueue {
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head{0};     // Next position to pop, on its own cache line
+    alignas(64) std::atomic<size_t> tail{0};     // Next position to push
+
+public:
+    // The capacity is rounded up to a power of two
+    explicit BoundedQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) size *= 2;
+        cells.reset(new Cell[size]);
+        mask = size - 1;
+        for (size_t i = 0; i < size; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Returns false (and leaves value alone) if the queue is full
+    bool tryPush(T&& value) {
+        size_t position = tail.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[position & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t lap = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (lap == 0) {
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (lap < 0) {
+                return false;
+            } else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Returns false if the queue is empty
+    bool tryPop(T& value) {
+        size_t position = head.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[position & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t lap = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+            if (lap == 0) {
+                if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    value = std::move(cell.value);
+                    cell.sequence.store(position + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (lap < 0) {
+                return false;
+            } else {
+                position = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Items in the queue right now (only a snapshot while other threads are pushing and popping)
+    size_t size() const {
+        size_t pushed = tail.load(std::memory_order_relaxed), popped = head.load(std::memory_order_relaxed);
+        return pushed > popped ? pushed - popped : 0;
+    }
+
+    size_t capacity() const { return mask + 1; }
+};
+
+// One student's essay waiting for a grader
+struct EssaySubmission {
+    const EssayExam* exam;
+    uint64_t studentId;
+};
+
+// A grader reads an essay and gives it a score (a person at the console, a script, or a simulation)
+using EssayGrader = std::function<int(const EssaySubmission&)>;
+using EssayCallback = std::function<void(const Expected<ExamResult>&)>;
+
+// Queue depth and end-to-end latency of an EssayGradingService
+struct EssayQueueMetrics {
+    size_t submitted = 0, completed = 0, rejected = 0;
+    size_t maxDepth = 0;
+    double meanDepth = 0;               // Queue depth seen by submissions, on average
+    double latencyP50 = 0, latencyP99 = 0, latencyMax = 0;     // Seconds from submission to result
+};
+
+// Asynchronous essay grading
+// Submissions go into a bounded lock-free queue and return at once with a future (or a callback to call).
+// Grader threads take essays off the queue, ask their EssayGrader for a score and post it back; the score's
+// 0-100 range is checked when it is posted, so a bad score becomes a GradeError on that essay's result.
+// A full queue refuses the submission with GradeError::QueueFull rather than blocking the submitter.
+class EssayGradingService {
+private:
+    struct Job {
+        EssaySubmission submission;
+        EssayCallback done;
+        std::chrono::steady_clock::time_point submittedAt;
+    };
+
+    // Latencies recorded by one grader thread, merged when metrics() is called
+    // A fixed-size histogram (about 15 KiB), so a service that runs for months uses no more memory than one that just started.
+    struct GraderLog {
+        std::mutex lock;
+        instrumentation::LatencyHistogram latencies;    // Nanoseconds
+    };
+
+    BoundedQueue<Job> queue;
+    EssayGrader grader;
+    std::vector<std::unique_ptr<GraderLog>> logs;
+    std::vector<std::thread> graders;
+    std::atomic<bool> stopping{false};
+    std::atomic<size_t> submittedCount{0}, completedCount{0}, rejectedCount{0}, maxDepth{0};
+
+    // Graders with nothing to do sleep here instead of polling the queue
+    // submit() only takes the lock to wake one when sleepingGraders says someone is asleep.
+    std::mutex parkLock;
+    std::condition_variable workReady;
+    std::atomic<unsigned> sleepingGraders{0};
+    std::atomic<uint64_t> depthTotal{0};
+
+    void gradeLoop(GraderLog& log);
+
+public:
+    EssayGradingService(size_t queueCapacity, unsigned graderCount, EssayGrader essayGrader)
+        : queue(queueCapacity), grader(std::move(essayGrader)) {
+        for (unsigned i = 0; i < std::max(graderCount, 1u); i++) {
+            logs.push_back(std::make_unique<GraderLog>());
+            GraderLog* log = logs.back().get();
+            graders.emplace_back([this, log] { gradeLoop(*log); });
+        }
+    }
+
+    // Grades everything still queued, then stops the graders
+    ~EssayGradingService() {
+        {
+            std::lock_guard<std::mutex> lock(parkLock);
+            stopping.store(true, std::memory_order_release);
+        }
+        workReady.notify_all();
+        for (std::thread& worker : graders) worker.join();
+    }
+
+    // Queues an essay; done(result) is called on a grader thread once it is graded
+    // Returns false straight away, without calling done, if the queue is full.
+    bool submit(const EssaySubmission& submission, EssayCallback done) {
+        Job job{submission, std::move(done), std::chrono::steady_clock::now()};
+        if (!queue.tryPush(std::move(job))) {
+            rejectedCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        submittedCount.fetch_add(1, std::memory_order_relaxed);
+        // Pairs with the fence in gradeLoop: either a parking grader sees this essay, or this sees the grader
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepingGraders.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(parkLock);
+            workReady.notify_one();
+        }
+        size_t depth = queue.size();
+        depthTotal.fetch_add(depth, std::memory_order_relaxed);
+        size_t deepest = maxDepth.load(std::memory_order_relaxed);
+        while (depth > deepest && !maxDepth.compare_exchange_weak(deepest, depth, std::memory_order_relaxed)) {}
+        return true;
+    }
+
+    // Queues an essay and returns a future for its result (GradeError::QueueFull at once if there was no room)
+    std::future<Expected<ExamResult>> submit(const EssaySubmission& submission) {
+        auto promised = std::make_shared<std::promise<Expected<ExamResult>>>();
+        std::future<Expected<ExamResult>> result = promised->get_future();
+        if (!submit(submission, [promised](const Expected<ExamResult>& outcome) { promised->set_value(outcome); })) {
+            promised->set_value(GradeError::QueueFull);
+        }
+        return result;
+    }
+
+    // True once every accepted essay has been graded
+    bool idle() const {
+        return completedCount.load(std::memory_order_acquire) == submittedCount.load(std::memory_order_relaxed);
+    }
+
+    EssayQueueMetrics metrics();
+};
+
+// Essay submission through a grading service, the result arrives through the returned future
+std::future<Expected<ExamResult>> submitForGrading(const EssayExam& exam, uint64_t studentId, EssayGradingService& service);
+
+// Grader that types the score in at the console
+int consoleGrader(const EssaySubmission&);
+
+// Grader that replays scores from a file, one integer per line (e.g. scores captured from real graders)
+// The scores are used in order and start again from the top when they run out.
+class ScriptedGrader {
+private:
+    std::shared_ptr<std::vector<int>> scores;
+    std::shared_ptr<std::atomic<size_t>> next;
+
+public:
+    explicit ScriptedGrader(const std::string& path);
+
+    int operator()(const EssaySubmission&) const {
+        return (*scores)[next->fetch_add(1, std::memory_order_relaxed) % scores->size()];
+    }
+};
+
+// Thread pool where each worker has its own task queue
+// A worker runs tasks from the back of its own queue and, when that is empty, steals from the front of
+// another worker's queue, so uneven chunks of work still keep every core busy.
+class WorkStealingPool {
+private:
+    struct TaskQueue {
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<TaskQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> nextQueue{0};    // Round-robin target for tasks submitted from outside the pool
+    std::mutex stateLock;
+    std::condition_variable taskAvailable, allDone;
+    size_t queued = 0;              // Tasks waiting in any queue, changed under stateLock when it goes up
+    size_t unfinished = 0;          // Tasks submitted but not yet finished, under stateLock
+    bool stopping = false;
+
+    // Takes a task from queue self, or steals one from another queue
+    bool takeTask(size_t self, std::function<void()>& task) {
+        for (size_t k = 0; k < queues.size(); k++) {
+            TaskQueue& queue = *queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.lock);
+            if (!queue.tasks.empty()) {
+                if (k == 0) {
+                    task = std::move(queue.tasks.back());   // Own queue: newest task, its data is likely still in cache
+                    queue.tasks.pop_back();
+                } else {
+                    task = std::move(queue.tasks.front());  // Someone else's queue: oldest task
+                    queue.tasks.pop_front();
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void work(size_t self) {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(stateLock);
+                taskAvailable.wait(lock, [this] { return stopping || queued > 0; });
+                if (queued == 0) return;    // Stopping and nothing left to do
+                queued--;
+            }
+            // queued counted one task for us, so some queue holds one
+            while (!takeTask(self, task)) {
+                std::this_thread::yield();
+            }
+            task();
+            std::lock_guard<std::mutex> lock(stateLock);
+            if (--unfinished == 0) {
+                allDone.notify_all();
+            }
+        }
+    }
+
+public:
+    explicit WorkStealingPool(unsigned threadCount) {
+        threadCount = std::max(threadCount, 1u);
+        for (unsigned i = 0; i < threadCount; i++) {
+            queues.push_back(std::make_unique<TaskQueue>());
+        }
+        for (unsigned i = 0; i < threadCount; i++) {
+            workers.emplace_back([this, i] { work(i); });
+        }
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(stateLock);
+            stopping = true;
+        }
+        taskAvailable.notify_all();
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    void submit(std::function<void()> task) {
+        TaskQueue& queue = *queues[nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size()];
+        {
+            std::lock_guard<std::mutex> lock(queue.lock);
+            queue.tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(stateLock);
+            queued++;
+            unfinished++;
+        }
+        taskAvailable.notify_one();
+    }
+
+    // Blocks until every submitted task has finished
+    void wait() {
+        std::unique_lock<std::mutex> lock(stateLock);
+        allDone.wait(lock, [this] { return unfinished == 0; });
+    }
+
+    size_t size() const { return workers.size(); }
+};
+
+// ---------------------------------------------------------------------------------------------
+// Score aggregates
+// Running score summaries per subject and per exam, updated as each result is graded so the
+// dashboards never rescan old results. Percentiles come from a ScoreSketch, a histogram with one
+// bucket per whole percent. Scores are bounded (0-100%), so 101 buckets hold any distribution to the
+// percent, two sketches merge by adding their buckets, and a query reads 101 counters.
+// ---------------------------------------------------------------------------------------------
+
+struct ScoreTally;
+
+// Mergeable score distribution, safe to read while other threads record into it
+class ScoreSketch {
+public:
+    static constexpr int bucketCount = 101;     // One per whole percent, 0-100
+
+    // Whether a result is counted at all: ungraded results are not
+    static bool counts(const ExamResult& result) { return result.graded && result.outOf > 0; }
+
+    // Bucket of a counted result, its score rounded to a whole percent
+    static int percentOf(const ExamResult& result) {
+        uint64_t score = static_cast<uint64_t>(std::clamp(result.score, 0, result.outOf));
+        return static_cast<int>((score * 100 + result.outOf / 2) / result.outOf);
+    }
+
+    // Exact score in hundredths of a percent, for the mean
+    static uint64_t basisPointsOf(const ExamResult& result) {
+        uint64_t score = static_cast<uint64_t>(std::clamp(result.score, 0, result.outOf));
+        return (score * 10000 + result.outOf / 2) / result.outOf;
+    }
+
+private:
+    std::atomic<uint64_t> buckets[bucketCount] = {};
+    std::atomic<uint64_t> basisPointSum{0};
+
+public:
+    // Adds one result, two atomic adds
+    void record(const ExamResult& result) {
+        if (!counts(result)) {
+            return;
+        }
+        buckets[percentOf(result)].fetch_add(1, std::memory_order_relaxed);
+        basisPointSum.fetch_add(basisPointsOf(result), std::memory_order_relaxed);
+    }
+
+    // Adds every result counted in other into this sketch
+    void merge(const ScoreSketch& other) {
+        for (int b = 0; b < bucketCount; b++) {
+            buckets[b].fetch_add(other.buckets[b].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        basisPointSum.fetch_add(other.basisPointSum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    // Adds a writer's private tally, one atomic add per bucket it used
+    void merge(const ScoreTally& tally);
+
+    uint64_t count() const {
+        uint64_t total = 0;
+        for (const auto& bucket : buckets) total += bucket.load(std::memory_order_relaxed);
+        return total;
+    }
+
+    // Mean score in percent, 0 when nothing has been recorded
+    // The sum and the buckets are separate counters, so while writers are busy the mean can be off by the few results in flight.
+    double mean() const {
+        uint64_t results = count();
+        return results == 0 ? 0.0 : basisPointSum.load(std::memory_order_relaxed) / 100.0 / results;
+    }
+
+    // Lowest whole percent with at least a fraction p (0-1) of the scores at or below it, -1 when nothing has been recorded
+    // The buckets are copied first, so the answer always comes from one consistent set of counts.
+    int percentile(double p) const {
+        uint64_t counts[bucketCount];
+        uint64_t total = 0;
+        for (int b = 0; b < bucketCount; b++) {
+            counts[b] = buckets[b].load(std::memory_order_relaxed);
+            total += counts[b];
+        }
+        if (total == 0) {
+            return -1;
+        }
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(std::clamp(p, 0.0, 1.0) * total)));
+        uint64_t seen = 0;
+        for (int b = 0; b < bucketCount; b++) {
+            seen += counts[b];
+            if (seen >= rank) return b;
+        }
+        return bucketCount - 1;
+    }
+};
+
+// Plain counts with the same buckets as a ScoreSketch, for one writer
+// A batch writer tallies here without atomics and merges into the shared sketch once per batch,
+// which matters when most results land in the same few buckets: each atomic add is a locked instruction.
+struct ScoreTally {
+    uint32_t buckets[ScoreSketch::bucketCount] = {};
+    uint64_t basisPointSum = 0;
+
+    void record(const ExamResult& result) {
+        if (ScoreSketch::counts(result)) {
+            buckets[ScoreSketch::percentOf(result)]++;
+            basisPointSum += ScoreSketch::basisPointsOf(result);
+        }
+    }
+};
+
+inline void ScoreSketch::merge(const ScoreTally& tally) {
+    for (int b = 0; b < bucketCount; b++) {
+        if (tally.buckets[b] != 0) buckets[b].fetch_add(tally.buckets[b], std::memory_order_relaxed);
+    }
+    basisPointSum.fetch_add(tally.basisPointSum, std::memory_order_relaxed);
+}
+
+// Score sketches per subject and per exam ID (an exam ID belongs to one subject)
+// The sketch maps only grow, and each sketch stays at the same address for the life of this object,
+// so writers look a sketch up once (under a shared lock) and then record with atomic adds only.
+class ScoreAggregates {
+public:
+    struct Sketches {
+        ScoreSketch* subject;
+        ScoreSketch* exam;
+    };
+
+private:
+    // An exam's entry also points at its subject's sketch, so recording a result is one lookup
+    struct ExamEntry {
+        std::unique_ptr<ScoreSketch> sketch;
+        ScoreSketch* subject;
+    };
+
+    // Both maps are searched with a string_view, without building a std::string
+    mutable std::shared_mutex keysLock;     // Guards the two maps, not the sketches in them
+    StringMap<std::unique_ptr<ScoreSketch>> subjects;
+    StringMap<ExamEntry> exams;
+
+public:
+    // The sketches an exam's results go into, created on first use
+    Sketches sketchesFor(const Exam& exam);
+
+    void record(const Exam& exam, const ExamResult& result) {
+        Sketches sketches = sketchesFor(exam);
+        sketches.subject->record(result);
+        sketches.exam->record(result);
+    }
+
+    // nullptr if no result for that subject or exam has been recorded
+    const ScoreSketch* subject(std::string_view name) const {
+        std::shared_lock<std::shared_mutex> lock(keysLock);
+        auto found = subjects.find(name);
+        return found == subjects.end() ? nullptr : found->second.get();
+    }
+
+    const ScoreSketch* exam(std::string_view examID) const {
+        std::shared_lock<std::shared_mutex> lock(keysLock);
+        auto found = exams.find(examID);
+        return found == exams.end() ? nullptr : found->second.sketch.get();
+    }
+
+    // Sorted names, for listing every summary
+    std::vector<std::string> subjectNames() const;
+    std::vector<std::string> examIDs() const;
+};
+
+// One student's sitting of a multiple choice exam
+struct Submission {
+    const MultipleChoiceExam* exam;
+    uint64_t studentId;
+};
+
+// Grades many multiple choice submissions in parallel
+// Submission i is graded with the random bits splitmix64(seed + i * golden ratio), so for a fixed seed
+// the results are the same with any number of threads.
+class GradingEngine {
+private:
+    WorkStealingPool pool;
+    ScoreAggregates* scores = nullptr;      // Not owned, every graded result is recorded into it if set
+
+public:
+    explicit GradingEngine(unsigned threadCount = std::thread::hardware_concurrency()) : pool(threadCount) {}
+
+    // Grades every submission on the pool, chunkSize submissions per job (a chunkSize of 0 is taken as 1)
+    std::vector<ExamResult> gradeAll(const std::vector<Submission>& submissions, uint64_t seed, size_t chunkSize = 4096);
+
+    // Keeps score summaries up to date with every result graded from now on; call before gradeAll
+    // Results are added to the summaries a chunk at a time.
+    void trackScores(ScoreAggregates* totals) { scores = totals; }
+
+    size_t threadCount() const { return pool.size(); }
+};
+
+// ---------------------------------------------------------------------------------------------
+// Exam store files
+// Exams, their answer keys and grading results saved in one compact binary file, so the grading service
+// can restart by mapping the file instead of rebuilding its state. The layout (little-endian) is:
+//   StoreHeader
+//   ExamRecord[examCount]             fixed size, strings are (offset, length) pairs into the string table
+//   uint64_t[keyWordCount]            every multiple choice answer key, in AnswerSheet layout
+//   ResultRecord[resultCount]         sorted by exam, then student, so a lookup is a binary search
+//   char[stringBytes]                 the string table: every distinct ID, subject and topic once
+// Each section starts on an 8 byte boundary. Opening a file checks the header, every exam record and every
+// result record (exam index, score and sort order) in one pass over the mapping; results then stay in the
+// mapping and are read one at a time when asked for.
+// ---------------------------------------------------------------------------------------------
+
+static_assert(std::endian::native == std::endian::little, "exam store files are written in little-endian byte order");
+
+inline constexpr char examStoreMagic[8] = {'E', 'X', 'A', 'M', 'S', 'T', 'O', 'R'};
+inline constexpr uint32_t examStoreVersion = 1;    // Readers refuse files from a newer version
+
+struct StoreHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;        // sizeof(StoreHeader) when written, so later versions can add fields at the end
+    uint64_t examCount;
+    uint64_t keyWordCount;
+    uint64_t resultCount;
+    uint64_t stringBytes;
+    uint64_t examOffset;        // Byte offset of each section from the start of the file
+    uint64_t keyOffset;
+    uint64_t resultOffset;
+    uint64_t stringOffset;
+};
+static_assert(sizeof(StoreHeader) == 80, "exam store headers are 80 bytes");
+
+struct StringRef {
+    uint32_t offset;
+    uint32_t length;
+};
+
+enum class StoredExamKind : uint8_t { MultipleChoice = 1, Essay = 2 };
+
+struct ExamRecord {
+    StringRef id;
+    StringRef subject;
+    StringRef topic;            // Empty for multiple choice exams
+    int32_t duration;
+    int32_t questions;          // 0 for essays
+    uint32_t keyWord;           // Index of the exam's first answer key word
+    uint8_t kind;               // A StoredExamKind
+    uint8_t padding[3];
+};
+static_assert(sizeof(ExamRecord) == 40, "exam records are 40 bytes");
+
+struct ResultRecord {
+    uint64_t studentId;
+    uint32_t examIndex;
+    uint16_t score;
+    uint16_t outOf;             // 0 when the submission could not be graded
+};
+static_assert(sizeof(ResultRecord) == 16, "result records are 16 bytes");
+
+// One exam as stored in a file; the strings point into the mapping and live as long as the reader
+struct StoredExam {
+    std::string_view id;
+    std::string_view subject;
+    std::string_view topic;
+    int duration;
+    int questions;
+    StoredExamKind kind;
+};
+
+struct StoredResult {
+    uint64_t studentId;
+    uint32_t examIndex;
+    ExamResult result;
+};
+
+// Collects exams and results in memory, then writes them as an exam store file
+class ExamStoreWriter {
+private:
+    std::vector<ExamRecord> exams;
+    std::vector<uint64_t> keyWords;
+    std::vector<ResultRecord> results;
+    std::string strings;
+    StringMap<StringRef> stringIndex;       // Each distinct string is stored once, found again by string_view
+
+    StringRef addString(std::string_view text) {
+        auto found = stringIndex.find(text);
+        if (found != stringIndex.end()) {
+            return found->second;
+        }
+        if (strings.size() + text.size() > UINT32_MAX) {
+            throw std::length_error("ExamStoreWriter: string table is full");
+        }
+        StringRef ref{static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(text.size())};
+        strings.append(text);
+        stringIndex.emplace(text, ref);
+        return ref;
+    }
+
+    uint32_t addRecord(const Exam& exam, StoredExamKind kind, std::string_view topic, int questions) {
+        ExamRecord record = {addString(exam.getExamID()), addString(exam.getSubject()), addString(topic),
+                             exam.getDuration(), questions, static_cast<uint32_t>(keyWords.size()), static_cast<uint8_t>(kind), {0, 0, 0}};
+        exams.push_back(record);
+        return static_cast<uint32_t>(exams.size() - 1);
+    }
+
+    // Pads the file with zeros up to the next 8 byte boundary
+    static void align(BufferedWriter& writer) {
+        while (writer.bytesWritten() % 8 != 0) {
+            writer.write('\0');
+        }
+    }
+
+    template<typename Record>
+    static void writeRecords(BufferedWriter& writer, const std::vector<Record>& records) {
+        writer.write(std::string_view(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(Record)));
+    }
+
+public:
+    // Each addExam returns the exam's index, which is what addResult takes
+    uint32_t addExam(const MultipleChoiceExam& exam) {
+        if (exam.getQuestions() > UINT16_MAX) {
+            throw std::invalid_argument("ExamStoreWriter: too many questions to store a score");
+        }
+        uint32_t index = addRecord(exam, StoredExamKind::MultipleChoice, "", exam.getQuestions());
+        const AnswerSheet& key = exam.getAnswerKey();
+        keyWords.insert(keyWords.end(), key.data(), key.data() + 3 * key.blocks());
+        return index;
+    }
+
+    uint32_t addExam(const EssayExam& exam) {
+        return addRecord(exam, StoredExamKind::Essay, exam.getTopic(), 0);
+    }
+
+    void addResult(uint32_t examIndex, uint64_t studentId, const ExamResult& result) {
+        if (examIndex >= exams.size()) {
+            throw std::out_of_range("ExamStoreWriter::addResult: no such exam");
+        }
+        bool graded = result.graded && result.outOf > 0;
+        // Records are stored as 16 bit counts, and the reader refuses a score above its total,
+        // so a result that would not read back is refused here instead of producing a damaged file
+        if (graded && (result.score < 0 || result.score > result.outOf || result.outOf > UINT16_MAX)) {
+            throw std::out_of_range("ExamStoreWriter::addResult: score must be in 0..outOf and outOf at most 65535");
+        }
+        results.push_back({studentId, examIndex, static_cast<uint16_t>(graded ? result.score : 0), static_cast<uint16_t>(graded ? result.outOf : 0)});
+    }
+
+    size_t examCount() const { return exams.size(); }
+    size_t resultCount() const { return results.size(); }
+
+    // Writes everything added so far to path (replacing the file)
+    void save(const std::string& path);
+};
+
+// Reads an exam store file in place through a memory mapping
+// Throws runtime_error if the file is not an exam store, comes from a newer version or is cut short.
+class ExamStoreReader {
+private:
+    MappedFile file;
+    StoreHeader header;
+    std::unordered_map<std::string_view, size_t> examsById;   // Keys point into the mapping
+
+    // Records are copied out with memcpy, which compiles to plain loads and needs no alignment or lifetime guarantees
+    template<typename Record>
+    Record record(uint64_t sectionOffset, size_t index) const {
+        Record value;
+        std::memcpy(&value, file.data() + sectionOffset + index * sizeof(Record), sizeof(Record));
+        return value;
+    }
+
+    std::string_view text(StringRef ref) const {
+        return std::string_view(file.data() + header.stringOffset + ref.offset, ref.length);
+    }
+
+    static void checkIndex(size_t index, uint64_t count, const char* what) {
+        if (index >= count) {
+            throw std::out_of_range(std::string("No ") + what + " " + std::to_string(index) + " in the exam store (" + std::to_string(count) + ")");
+        }
+    }
+
+    // True if count records of recordSize bytes starting at offset lie inside the file
+    bool sectionFits(uint64_t offset, uint64_t count, size_t recordSize) const {
+        return offset % 8 == 0 && offset <= file.size() && count <= (file.size() - offset) / recordSize;
+    }
+
+public:
+    explicit ExamStoreReader(const std::string& path);
+
+    size_t examCount() const { return header.examCount; }
+    size_t resultCount() const { return header.resultCount; }
+    size_t fileSize() const { return file.size(); }
+
+    // The accessors taking an index throw std::out_of_range for an index past the end
+    StoredExam exam(size_t index) const {
+        checkIndex(index, header.examCount, "exam");
+        ExamRecord exam = record<ExamRecord>(header.examOffset, index);
+        return {text(exam.id), text(exam.subject), text(exam.topic), exam.duration, exam.questions, static_cast<StoredExamKind>(exam.kind)};
+    }
+
+    // Index of the exam with this ID, if there is one
+    std::optional<size_t> findExam(std::string_view id) const {
+        auto found = examsById.find(id);
+        return found != examsById.end() ? std::optional<size_t>(found->second) : std::nullopt;
+    }
+
+    // Rebuilds exam index as a MultipleChoiceExam (with its stored answer key) or an EssayExam
+    std::unique_ptr<Exam> restoreExam(size_t index, std::pmr::memory_resource* memory = std::pmr::get_default_resource()) const;
+
+    StoredResult result(size_t index) const {
+        checkIndex(index, header.resultCount, "result");
+        ResultRecord stored = record<ResultRecord>(header.resultOffset, index);
+        return {stored.studentId, stored.examIndex, ExamResult{stored.score, stored.outOf, stored.outOf > 0}};
+    }
+
+    // Results [first, last) of exam examIndex, found by binary search
+    std::pair<size_t, size_t> resultRange(uint32_t examIndex) const;
+
+    // A student's result for one exam, if the file has it
+    std::optional<ExamResult> findResult(uint32_t examIndex, uint64_t studentId) const;
+};
+
+#endif
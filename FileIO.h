@@ -0,0 +1,161 @@
+/*
+File input and output helpers shared by both assignment programs.
+
+MappedFile maps a whole file into memory, so a parser can read it in place with no copies and no
+per-line strings. BufferedWriter collects output in one large buffer and writes it out in big blocks,
+instead of a system call (or an endl flush) for every line.
+POSIX only (Linux, macOS).
+*/
+
+#ifndef FILE_IO_H
+#define FILE_IO_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+
+public:
+    explicit MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open " + path);
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Cannot read the size of " + path);
+        }
+        length = static_cast<size_t>(info.st_size);
+        if (length > 0) {
+            void* mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("Cannot map " + path);
+            }
+            ::madvise(mapping, length, MADV_SEQUENTIAL);    // Tell the kernel to read ahead
+            bytes = static_cast<const char*>(mapping);
+        }
+        ::close(fd);    // The mapping stays valid after the descriptor is closed
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (bytes != nullptr) {
+            ::munmap(const_cast<char*>(bytes), length);
+        }
+    }
+
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+    std::string_view view() const { return std::string_view(bytes, length); }
+};
+
+// Output file written through one large buffer
+// The buffer is sized once, in the constructor, and never grows: a write that does not fit flushes
+// first, and a string longer than the whole buffer goes straight to the file.
+class BufferedWriter {
+private:
+    static constexpr size_t minCapacity = 4096;    // Room for the longest single number (see writeFixed)
+
+    int fd;
+    std::vector<char> buffer;
+    size_t used = 0;
+    size_t written = 0;     // Bytes already handed to the operating system
+
+    void writeAll(const char* bytes, size_t count) {
+        size_t done = 0;
+        while (done < count) {
+            ssize_t result = ::write(fd, bytes + done, count - done);
+            if (result < 0) {
+                throw std::runtime_error("Write failed");
+            }
+            done += static_cast<size_t>(result);
+        }
+        written += count;
+    }
+
+    // Makes sure at least bytes more characters fit in the buffer, bytes <= minCapacity
+    void reserve(size_t bytes) {
+        if (bytes > buffer.size() - used) {
+            flush();
+        }
+    }
+
+public:
+    explicit BufferedWriter(const std::string& path, size_t capacity = 1 << 20) : buffer(std::max(capacity, minCapacity)) {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot create " + path);
+        }
+    }
+
+    BufferedWriter(const BufferedWriter&) = delete;
+    BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+    ~BufferedWriter() {
+        try {
+            flush();
+        } catch (...) {
+            // A destructor must not throw; call flush() first to see write errors
+        }
+        ::close(fd);
+    }
+
+    // Writes everything in the buffer to the file
+    void flush() {
+        size_t count = used;
+        used = 0;
+        writeAll(buffer.data(), count);
+    }
+
+    void write(std::string_view text) {
+        if (text.size() > buffer.size() - used) {
+            flush();
+            if (text.size() > buffer.size()) {
+                writeAll(text.data(), text.size());
+                return;
+            }
+        }
+        std::memcpy(buffer.data() + used, text.data(), text.size());
+        used += text.size();
+    }
+
+    void write(char c) {
+        reserve(1);
+        buffer[used++] = c;
+    }
+
+    // Integers and fixed-point numbers are formatted straight into the buffer with to_chars
+    template<typename Integer>
+    void writeInteger(Integer value) {
+        reserve(24);
+        used = std::to_chars(buffer.data() + used, buffer.data() + buffer.size(), value).ptr - buffer.data();
+    }
+
+    void writeFixed(double value, int decimals) {
+        reserve(352);   // Longest fixed-point double
+        used = std::to_chars(buffer.data() + used, buffer.data() + buffer.size(), value, std::chars_format::fixed, decimals).ptr - buffer.data();
+    }
+
+    size_t bytesWritten() const { return written + used; }
+};
+
+#endif
@@ -0,0 +1,412 @@
+/*
+Hot path instrumentation shared by both assignment programs: counters and latency histograms.
+
+A Timer is a named latency histogram and a Counter a named running total. Both are declared once as
+globals and then recorded from any thread: a ScopedTimer around a call records how long it took.
+Each thread records into its own slots, so recording takes no lock and shares no cache lines with
+other threads. snapshot() adds up every thread's slots on demand and can be printed as text or JSON.
+
+The histograms are HDR-style: 32 linear buckets for every power of two of nanoseconds, so any
+percentile is known to within about 3% whatever the range of the latencies.
+
+Build with -DRIMS_INSTRUMENTATION=0 to compile all of this out: ScopedTimer becomes an empty object,
+recording does nothing and snapshot() is always empty.
+*/
+
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#ifndef RIMS_INSTRUMENTATION
+#define RIMS_INSTRUMENTATION 1
+#endif
+
+namespace instrumentation {
+    inline constexpr bool enabled = RIMS_INSTRUMENTATION != 0;
+    inline constexpr size_t maxTimers = 32;
+    inline constexpr size_t maxCounters = 32;
+    inline constexpr size_t maxThreads = 1024;     // Threads whose slots snapshot() can see while they run
+
+    // Log-linear histogram of latencies in nanoseconds
+    // Values below 32 get a bucket each; above that, every power of two is split into 32 equal buckets.
+    class LatencyHistogram {
+    public:
+        static constexpr int subBucketBits = 5;
+        static constexpr size_t subBuckets = size_t(1) << subBucketBits;
+        static constexpr size_t bucketCount = (64 - subBucketBits + 1) * subBuckets;
+
+        static constexpr size_t bucketOf(uint64_t nanoseconds) {
+            if (nanoseconds < subBuckets) {
+                return static_cast<size_t>(nanoseconds);
+            }
+            int exponent = std::bit_width(nanoseconds) - 1;
+            size_t sub = static_cast<size_t>(nanoseconds >> (exponent - subBucketBits)) & (subBuckets - 1);
+            return static_cast<size_t>(exponent - subBucketBits + 1) * subBuckets + sub;
+        }
+
+        // Smallest and largest value that land in bucket
+        static constexpr uint64_t bucketLow(size_t bucket) {
+            if (bucket < subBuckets) {
+                return bucket;
+            }
+            int exponent = static_cast<int>(bucket / subBuckets) + subBucketBits - 1;
+            return (uint64_t(1) << exponent) | (uint64_t(bucket % subBuckets) << (exponent - subBucketBits));
+        }
+        static constexpr uint64_t bucketHigh(size_t bucket) {
+            return bucket + 1 == bucketCount ? std::numeric_limits<uint64_t>::max() : bucketLow(bucket + 1) - 1;
+        }
+
+    private:
+        std::array<uint64_t, bucketCount> buckets{};
+        uint64_t total = 0;
+        uint64_t sum = 0;
+        uint64_t smallest = std::numeric_limits<uint64_t>::max();
+        uint64_t largest = 0;
+
+    public:
+        void record(uint64_t nanoseconds, uint64_t times = 1) {
+            buckets[bucketOf(nanoseconds)] += times;
+            total += times;
+            sum += nanoseconds * times;
+            smallest = std::min(smallest, nanoseconds);
+            largest = std::max(largest, nanoseconds);
+        }
+
+        // Adds count values from bucket, whose sum, min and max are given separately (see merge and snapshot)
+        void addBucket(size_t bucket, uint64_t count) {
+            buckets[bucket] += count;
+            total += count;
+        }
+        void addSummary(uint64_t valueSum, uint64_t minimum, uint64_t maximum) {
+            sum += valueSum;
+            smallest = std::min(smallest, minimum);
+            largest = std::max(largest, maximum);
+        }
+
+        void merge(const LatencyHistogram& other) {
+            for (size_t b = 0; b < bucketCount; b++) {
+                buckets[b] += other.buckets[b];
+            }
+            total += other.total;
+            addSummary(other.sum, other.smallest, other.largest);
+        }
+
+        uint64_t count() const { return total; }
+        uint64_t min() const { return total ? smallest : 0; }
+        uint64_t max() const { return largest; }
+        double mean() const { return total ? double(sum) / total : 0; }
+
+        // Value at quantile q (0-1): the middle of the bucket it falls in, clamped to the recorded min and max
+        uint64_t percentile(double q) const {
+            if (total == 0) {
+                return 0;
+            }
+            uint64_t rank = static_cast<uint64_t>(q * (total - 1)) + 1;
+            uint64_t seen = 0;
+            for (size_t b = 0; b < bucketCount; b++) {
+                seen += buckets[b];
+                if (seen >= rank) {
+                    uint64_t middle = bucketLow(b) + (std::min(bucketHigh(b), largest) - bucketLow(b)) / 2;
+                    return std::clamp(middle, smallest, largest);
+                }
+            }
+            return largest;
+        }
+    };
+
+    static_assert(LatencyHistogram::bucketOf(31) == 31 && LatencyHistogram::bucketOf(32) == 32 && LatencyHistogram::bucketOf(64) == 64);
+    static_assert(LatencyHistogram::bucketLow(LatencyHistogram::bucketOf(1000000)) <= 1000000 && LatencyHistogram::bucketHigh(LatencyHistogram::bucketOf(1000000)) >= 1000000);
+    static_assert(LatencyHistogram::bucketOf(std::numeric_limits<uint64_t>::max()) == LatencyHistogram::bucketCount - 1);
+
+    // One thread's histogram for one timer
+    // Only its own thread writes it (plain load and store, no locked add); snapshot() may read it at any time.
+    struct ThreadHistogram {
+        std::array<std::atomic<uint64_t>, LatencyHistogram::bucketCount> buckets{};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> smallest{std::numeric_limits<uint64_t>::max()};
+        std::atomic<uint64_t> largest{0};
+
+        static void bump(std::atomic<uint64_t>& slot, uint64_t amount) {
+            slot.store(slot.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+        }
+
+        void record(uint64_t nanoseconds) {
+            bump(buckets[LatencyHistogram::bucketOf(nanoseconds)], 1);
+            bump(sum, nanoseconds);
+            if (nanoseconds < smallest.load(std::memory_order_relaxed)) smallest.store(nanoseconds, std::memory_order_relaxed);
+            if (nanoseconds > largest.load(std::memory_order_relaxed)) largest.store(nanoseconds, std::memory_order_relaxed);
+        }
+
+        void addTo(LatencyHistogram& histogram) const {
+            for (size_t b = 0; b < LatencyHistogram::bucketCount; b++) {
+                if (uint64_t count = buckets[b].load(std::memory_order_relaxed)) {
+                    histogram.addBucket(b, count);
+                }
+            }
+            histogram.addSummary(sum.load(std::memory_order_relaxed), smallest.load(std::memory_order_relaxed), largest.load(std::memory_order_relaxed));
+        }
+    };
+
+    // Everything one thread has recorded; histograms are only allocated for the timers the thread uses
+    struct ThreadSlots {
+        std::array<std::atomic<ThreadHistogram*>, maxTimers> histograms{};
+        std::array<std::atomic<uint64_t>, maxCounters> counters{};
+
+        ThreadSlots() noexcept;
+        ~ThreadSlots();
+    };
+
+    // Names of the timers and counters, the live threads' slots, and the totals of threads that have exited
+    // A thread claims a free entry of threads with a compare-and-swap; the lock is only taken to read the
+    // slots (snapshot) and to give an entry back (a thread exiting), so registering never locks or allocates.
+    struct Registry {
+        std::mutex lock;
+        std::vector<std::string> timerNames;
+        std::vector<std::string> counterNames;
+        std::array<std::atomic<ThreadSlots*>, maxThreads> threads{};
+        std::array<LatencyHistogram, maxTimers> retiredHistograms;
+        std::array<uint64_t, maxCounters> retiredCounters{};
+
+        static Registry& instance() {
+            static Registry registry;   // Never destroyed before the last thread_local that uses it
+            return registry;
+        }
+
+        size_t add(std::vector<std::string>& names, const char* name, size_t limit) {
+            std::lock_guard<std::mutex> guard(lock);
+            if (names.size() == limit) {
+                return limit;       // Too many; this one records nothing
+            }
+            names.emplace_back(name);
+            return names.size() - 1;
+        }
+    };
+
+    // Runs on a thread's first record, which can be inside a noexcept function such as Exam::validate,
+    // so it must not throw. If all maxThreads entries are taken, snapshot() only sees this thread's
+    // totals once it has exited.
+    inline ThreadSlots::ThreadSlots() noexcept {
+        for (std::atomic<ThreadSlots*>& entry : Registry::instance().threads) {
+            ThreadSlots* free = nullptr;
+            if (entry.compare_exchange_strong(free, this, std::memory_order_release, std::memory_order_relaxed)) {
+                return;
+            }
+        }
+    }
+
+    // A thread that exits hands its totals over to the registry, so snapshot() still sees them
+    inline ThreadSlots::~ThreadSlots() {
+        Registry& registry = Registry::instance();
+        std::lock_guard<std::mutex> guard(registry.lock);
+        for (size_t t = 0; t < maxTimers; t++) {
+            if (ThreadHistogram* histogram = histograms[t].load(std::memory_order_relaxed)) {
+                histogram->addTo(registry.retiredHistograms[t]);
+                delete histogram;
+            }
+        }
+        for (size_t c = 0; c < maxCounters; c++) {
+            registry.retiredCounters[c] += counters[c].load(std::memory_order_relaxed);
+        }
+        for (std::atomic<ThreadSlots*>& entry : registry.threads) {
+            if (entry.load(std::memory_order_relaxed) == this) {
+                entry.store(nullptr, std::memory_order_relaxed);
+                break;
+            }
+        }
+    }
+
+    inline ThreadSlots& threadSlots() noexcept {
+        thread_local ThreadSlots slots;
+        return slots;
+    }
+
+    // Counters and timers are recorded from noexcept code, so a thread's first record must not be able to throw
+    static_assert(std::is_nothrow_default_constructible_v<ThreadSlots>, "registering a thread's slots must not throw");
+
+    // A named latency histogram, declared once (e.g. as an inline global) and recorded from any thread
+    class Timer {
+    private:
+        size_t id = maxTimers;
+
+    public:
+        explicit Timer(const char* name) {
+            if constexpr (enabled) {
+                Registry& registry = Registry::instance();
+                id = registry.add(registry.timerNames, name, maxTimers);
+            }
+        }
+
+        // Never throws: if this thread's histogram cannot be allocated, the sample is dropped
+        void record(uint64_t nanoseconds) const noexcept {
+            if constexpr (enabled) {
+                if (id == maxTimers) return;
+                std::atomic<ThreadHistogram*>& slot = threadSlots().histograms[id];
+                ThreadHistogram* histogram = slot.load(std::memory_order_relaxed);
+                if (histogram == nullptr) {
+                    histogram = new (std::nothrow) ThreadHistogram();
+                    if (histogram == nullptr) return;
+                    slot.store(histogram, std::memory_order_release);
+                }
+                histogram->record(nanoseconds);
+            }
+        }
+    };
+
+    // A named running total, e.g. the number of requests priced
+    class Counter {
+    private:
+        size_t id = maxCounters;
+
+    public:
+        explicit Counter(const char* name) {
+            if constexpr (enabled) {
+                Registry& registry = Registry::instance();
+                id = registry.add(registry.counterNames, name, maxCounters);
+            }
+        }
+
+        void add(uint64_t amount = 1) const noexcept {
+            if constexpr (enabled) {
+                if (id == maxCounters) return;
+                std::atomic<uint64_t>& slot = threadSlots().counters[id];
+                slot.store(slot.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    // Records the time from its construction to the end of the scope in timer
+#if RIMS_INSTRUMENTATION
+    class ScopedTimer {
+    private:
+        const Timer& timer;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        explicit ScopedTimer(const Timer& t) : timer(t), start(std::chrono::steady_clock::now()) {}
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+        ~ScopedTimer() {
+            timer.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()));
+        }
+    };
+#else
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(const Timer&) {}
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+    };
+#endif
+
+    // With instrumentation off there is nothing left to run: no state, and nothing to construct or destroy
+    static_assert(enabled || (std::is_empty_v<ScopedTimer> && std::is_trivially_destructible_v<ScopedTimer>),
+                  "a disabled ScopedTimer must compile to nothing");
+
+    struct TimerSummary {
+        std::string name;
+        LatencyHistogram histogram;
+    };
+
+    struct CounterSummary {
+        std::string name;
+        uint64_t value;
+    };
+
+    // Totals over all threads at one moment
+    struct Snapshot {
+        std::vector<TimerSummary> timers;
+        std::vector<CounterSummary> counters;
+
+        // One line per timer (count, mean and percentiles in microseconds) and per counter
+        std::string toText() const {
+            std::string text;
+            char line[256];
+            for (const TimerSummary& timer : timers) {
+                const LatencyHistogram& h = timer.histogram;
+                std::snprintf(line, sizeof(line), "  %-28s %10llu calls  mean %9.3f  p50 %9.3f  p99 %9.3f  p99.9 %9.3f  max %9.3f us\n",
+                              timer.name.c_str(), static_cast<unsigned long long>(h.count()), h.mean() / 1e3,
+                              h.percentile(0.5) / 1e3, h.percentile(0.99) / 1e3, h.percentile(0.999) / 1e3, h.max() / 1e3);
+                text += line;
+            }
+            for (const CounterSummary& counter : counters) {
+                std::snprintf(line, sizeof(line), "  %-28s %10llu\n", counter.name.c_str(), static_cast<unsigned long long>(counter.value));
+                text += line;
+            }
+            return text;
+        }
+
+        // {"timers": {name: {count, mean_ns, min_ns, p50_ns, p90_ns, p99_ns, p999_ns, max_ns}}, "counters": {name: value}}
+        // Timer and counter names are plain identifiers, so they need no escaping.
+        std::string toJson() const {
+            std::string json = "{\"timers\": {";
+            for (size_t i = 0; i < timers.size(); i++) {
+                const LatencyHistogram& h = timers[i].histogram;
+                char fields[320];
+                std::snprintf(fields, sizeof(fields),
+                              "\"count\": %llu, \"mean_ns\": %.1f, \"min_ns\": %llu, \"p50_ns\": %llu, \"p90_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu, \"max_ns\": %llu",
+                              static_cast<unsigned long long>(h.count()), h.mean(), static_cast<unsigned long long>(h.min()),
+                              static_cast<unsigned long long>(h.percentile(0.5)), static_cast<unsigned long long>(h.percentile(0.9)),
+                              static_cast<unsigned long long>(h.percentile(0.99)), static_cast<unsigned long long>(h.percentile(0.999)),
+                              static_cast<unsigned long long>(h.max()));
+                json += (i ? ", \"" : "\"") + timers[i].name + "\": {" + fields + "}";
+            }
+            json += "}, \"counters\": {";
+            for (size_t i = 0; i < counters.size(); i++) {
+                json += (i ? ", \"" : "\"") + counters[i].name + "\": " + std::to_string(counters[i].value);
+            }
+            return json + "}}";
+        }
+    };
+
+    // Adds up every thread's timers and counters (including threads that have exited)
+    // Threads keep recording meanwhile, so a busy timer may be a few calls ahead of another.
+    inline Snapshot snapshot() {
+        Snapshot result;
+        if constexpr (enabled) {
+            Registry& registry = Registry::instance();
+            std::lock_guard<std::mutex> guard(registry.lock);
+            for (size_t t = 0; t < registry.timerNames.size(); t++) {
+                TimerSummary summary{registry.timerNames[t], registry.retiredHistograms[t]};
+                for (const std::atomic<ThreadSlots*>& entry : registry.threads) {
+                    ThreadSlots* slots = entry.load(std::memory_order_acquire);
+                    if (slots == nullptr) continue;
+                    if (ThreadHistogram* histogram = slots->histograms[t].load(std::memory_order_acquire)) {
+                        histogram->addTo(summary.histogram);
+                    }
+                }
+                if (summary.histogram.count() > 0) {
+                    result.timers.push_back(std::move(summary));
+                }
+            }
+            for (size_t c = 0; c < registry.counterNames.size(); c++) {
+                uint64_t value = registry.retiredCounters[c];
+                for (const std::atomic<ThreadSlots*>& entry : registry.threads) {
+                    if (ThreadSlots* slots = entry.load(std::memory_order_acquire)) {
+                        value += slots->counters[c].load(std::memory_order_relaxed);
+                    }
+                }
+                if (value > 0) {
+                    result.counters.push_back({registry.counterNames[c], value});
+                }
+            }
+        }
+        return result;
+    }
+}
+
+#endif
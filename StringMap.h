@@ -0,0 +1,27 @@
+/*
+String-keyed hash map shared by both libraries.
+
+StringMap<Value> is a std::unordered_map from std::string that can also be searched with a
+std::string_view (or a string literal), without building a temporary std::string for every lookup.
+Used for interning names and looking up subjects, exams and stored strings by name.
+*/
+
+#ifndef STRING_MAP_H
+#define STRING_MAP_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Hashes std::string and std::string_view alike, so lookups can use either (transparent hashing)
+struct StringViewHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view text) const { return std::hash<std::string_view>()(text); }
+};
+
+template<typename Value>
+using StringMap = std::unordered_map<std::string, Value, StringViewHash, std::equal_to<>>;
+
+#endif
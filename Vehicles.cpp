@@ -0,0 +1,307 @@
+/*
+Vehicle hierarchy, pricing kernels, batch pricing and bookings (see Vehicles.h).
+*/
+
+#include "Vehicles.h"
+#include<iostream>
+#include<cmath>
+#include<cstring>
+#include<charconv>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include<immintrin.h>
+#define RIMS_X86_KERNELS 1     // SSE2/AVX2 pricing kernels are compiled in, see the pricing kernels section
+#endif
+using namespace std;
+
+// Hot path timers and counters (see Instrumentation.h)
+static instrumentation::Timer quoteTimer("pricing.quoteRentalCost");
+static instrumentation::Timer batchTimer("pricing.priceBatch");
+static instrumentation::Counter batchRequests("pricing.batchRequests");
+static instrumentation::Timer bookingTimer("booking.bookNow");
+static instrumentation::Counter bookingsRejected("booking.rejected");
+
+// Times only the pricing of a quote, so the console output of calculateRentalCost is not counted as pricing
+static double timedQuote(const Vehicle& vehicle, int days) {
+    instrumentation::ScopedTimer timing(quoteTimer);
+    return vehicle.quoteRentalCost(days);
+}
+
+// Prints the cost of renting this car
+void Car::calculateRentalCost(int days) {
+    double totalCost = timedQuote(*this, days);
+    cout << "Car Chosen! \nTotal Rental Cost: KES" << totalCost << " for " << days << " days." << endl;
+    // cout << "Car Chosen!" << endl;
+}
+
+// Prints the cost of renting this SUV
+void SUV::calculateRentalCost(int days) {
+    double totalCost = timedQuote(*this, days);
+    cout << "SUV Chosen! \nTotal Rental Cost: KES" << totalCost << " for " << days << " days." << endl;
+}
+
+// Prints the cost of renting this truck
+void Truck::calculateRentalCost(int days) {
+    double totalCost = timedQuote(*this, days);
+    cout << "Truck Chosen! \nTotal Rental Cost: KES" << totalCost << " for " << days << " days." << endl;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Pricing kernels
+// ---------------------------------------------------------------------------------------------
+
+const char* kernelIsaName(KernelIsa isa) {
+    switch (isa) {
+        case KernelIsa::SSE2: return "SSE2";
+        case KernelIsa::AVX2: return "AVX2";
+        default:              return "scalar";
+    }
+}
+
+// Best instruction set this CPU supports, detected once at runtime
+KernelIsa bestKernelIsa() {
+#ifdef RIMS_X86_KERNELS
+    static const KernelIsa best = __builtin_cpu_supports("avx2") ? KernelIsa::AVX2
+                                : __builtin_cpu_supports("sse2") ? KernelIsa::SSE2 : KernelIsa::Scalar;
+    return best;
+#else
+    return KernelIsa::Scalar;
+#endif
+}
+
+// Scalar kernel, also used for the last few elements of the vector kernels
+// attributeStride is 1 for one attribute per rental, or 0 when every rental uses attributes[0]
+template<typename VehicleKind, typename Attribute = typename Pricing<VehicleKind>::Attribute>
+static void rentalCostsScalar(const int* days, const Attribute* attributes, size_t attributeStride, double* costs, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        costs[i] = Pricing<VehicleKind>::rentalCost(days[i], attributes[i * attributeStride]);
+    }
+}
+
+#ifdef RIMS_X86_KERNELS
+// Two ints or floats widened to two doubles
+static inline __m128d loadTwo(const int* values) { return _mm_cvtepi32_pd(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(values))); }
+static inline __m128d loadTwo(const float* values) { return _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(values)))); }
+
+template<typename VehicleKind, typename Attribute = typename Pricing<VehicleKind>::Attribute>
+static void rentalCostsSSE2(const int* days, const Attribute* attributes, size_t attributeStride, double* costs, size_t count) {
+    using Policy = Pricing<VehicleKind>;
+    const __m128d rate = _mm_set1_pd(Policy::costPerDay);
+    const __m128d tonne = _mm_set1_pd(Pricing<Truck>::kilogramsPerTon);
+    const __m128d shared = _mm_set1_pd(attributes[0]);
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128d attribute = attributeStride ? loadTwo(attributes + i) : shared;
+        __m128d cost = _mm_mul_pd(_mm_mul_pd(rate, loadTwo(days + i)), attribute);
+        if constexpr (Policy::pricedPerTon) cost = _mm_div_pd(cost, tonne);
+        _mm_storeu_pd(costs + i, cost);
+    }
+    rentalCostsScalar<VehicleKind>(days + i, attributes + i * attributeStride, attributeStride, costs + i, count - i);
+}
+
+// Four ints or floats widened to four doubles
+__attribute__((target("avx2"))) static inline __m256d loadFour(const int* values) { return _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values))); }
+__attribute__((target("avx2"))) static inline __m256d loadFour(const float* values) { return _mm256_cvtps_pd(_mm_loadu_ps(values)); }
+
+template<typename VehicleKind, typename Attribute = typename Pricing<VehicleKind>::Attribute>
+__attribute__((target("avx2")))
+static void rentalCostsAVX2(const int* days, const Attribute* attributes, size_t attributeStride, double* costs, size_t count) {
+    using Policy = Pricing<VehicleKind>;
+    const __m256d rate = _mm256_set1_pd(Policy::costPerDay);
+    const __m256d tonne = _mm256_set1_pd(Pricing<Truck>::kilogramsPerTon);
+    const __m256d shared = _mm256_set1_pd(attributes[0]);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d attribute = attributeStride ? loadFour(attributes + i) : shared;
+        __m256d cost = _mm256_mul_pd(_mm256_mul_pd(rate, loadFour(days + i)), attribute);
+        if constexpr (Policy::pricedPerTon) cost = _mm256_div_pd(cost, tonne);
+        _mm256_storeu_pd(costs + i, cost);
+    }
+    rentalCostsScalar<VehicleKind>(days + i, attributes + i * attributeStride, attributeStride, costs + i, count - i);
+}
+#endif
+
+// Runs one kernel with the requested instruction set, falling back to scalar if it is not compiled in
+template<typename VehicleKind, typename Attribute = typename Pricing<VehicleKind>::Attribute>
+static void rentalCosts(KernelIsa isa, const int* days, const Attribute* attributes, size_t attributeStride, double* costs, size_t count) {
+    if (count == 0) return;
+#ifdef RIMS_X86_KERNELS
+    if (isa == KernelIsa::AVX2) return rentalCostsAVX2<VehicleKind>(days, attributes, attributeStride, costs, count);
+    if (isa == KernelIsa::SSE2) return rentalCostsSSE2<VehicleKind>(days, attributes, attributeStride, costs, count);
+#endif
+    rentalCostsScalar<VehicleKind>(days, attributes, attributeStride, costs, count);
+}
+
+// Public kernels, one per vehicle type. Same results as Pricing<Car/SUV/Truck>::rentalCost for every element.
+// Pass attributeStride = 0 to price every rental with the single attribute value *numDoors (etc.).
+void carRentalCosts(const int* days, const int* numDoors, size_t attributeStride, double* costs, size_t count, KernelIsa isa) {
+    rentalCosts<Car>(isa, days, numDoors, attributeStride, costs, count);
+}
+
+void suvRentalCosts(const int* days, const int* peopleCapacity, size_t attributeStride, double* costs, size_t count, KernelIsa isa) {
+    rentalCosts<SUV>(isa, days, peopleCapacity, attributeStride, costs, count);
+}
+
+void truckRentalCosts(const int* days, const float* cargoCapacity, size_t attributeStride, double* costs, size_t count, KernelIsa isa) {
+    rentalCosts<Truck>(isa, days, cargoCapacity, attributeStride, costs, count);
+}
+
+// Adds up a batch of costs exactly, as whole cents in a 64 bit integer
+// Summing millions of doubles one by one lets rounding errors pile up; integer cents do not drift.
+long long totalCents(span<const double> costs) {
+    long long cents = 0;
+    for (double cost : costs) {
+        cents += llround(cost * 100);
+    }
+    return cents;
+}
+
+// Groups the requests by type with a counting sort, then prices each group in its own loop
+void BatchPricer::priceBatch(span<const RentalRequest> requests, span<double> costs) {
+    if (costs.size() < requests.size()) {
+        throw invalid_argument("priceBatch: output span is smaller than the request span");
+    }
+    instrumentation::ScopedTimer timing(batchTimer);
+    batchRequests.add(requests.size());
+
+    // Pass 1: count how many requests there are of each type
+    // Slot 0 collects unknown types, slots 1-3 are Car, SUV and Truck
+    size_t counts[4] = {0, 0, 0, 0};
+    for (const RentalRequest& request : requests) {
+        counts[vehicleTypeSlot(request.type)]++;
+    }
+
+    // Pass 2: group the request positions by type (a counting sort, no branches on the type)
+    size_t next[4] = {0, counts[0], counts[0] + counts[1], counts[0] + counts[1] + counts[2]};
+    const size_t carBegin = next[1], suvBegin = next[2], truckBegin = next[3];
+    order.resize(requests.size());
+    for (size_t i = 0; i < requests.size(); i++) {
+        order[next[vehicleTypeSlot(requests[i].type)]++] = i;
+    }
+
+    // Pass 3: one tight loop per type, each using the same Pricing formula as the per-object path
+    // (The arrays here are scattered by order[], so the contiguous-array pricing kernels would need an extra gather pass)
+    for (size_t k = 0; k < carBegin; k++) {
+        costs[order[k]] = 0.0;
+    }
+    for (size_t k = carBegin; k < suvBegin; k++) {
+        costs[order[k]] = Pricing<Car>::rentalCost(requests[order[k]].days, numDoors);
+    }
+    for (size_t k = suvBegin; k < truckBegin; k++) {
+        costs[order[k]] = Pricing<SUV>::rentalCost(requests[order[k]].days, peopleCapacity);
+    }
+    for (size_t k = truckBegin; k < requests.size(); k++) {
+        costs[order[k]] = Pricing<Truck>::rentalCost(requests[order[k]].days, cargoCapacity);
+    }
+}
+
+BookingResult BookingService::bookNow(const BookingRequest& request) {
+    instrumentation::ScopedTimer timing(bookingTimer);
+    if (request.vehicle >= fleet.size() || !calendars[request.vehicle].tryClaim(request.firstDay, request.days)) {
+        bookingsRejected.add();
+        return {false, 0.0, {}};
+    }
+    const Vehicle& vehicle = *fleet[request.vehicle];
+    double cost = vehicle.quoteRentalCost(request.days);
+    BookingHandle handle{nextBookingId.fetch_add(1, memory_order_relaxed)};
+    {
+        BookingShard& shard = shards[handle.id % shardCount];
+        lock_guard<mutex> lock(shard.lock);
+        shard.bookings.emplace(handle.id, LiveBooking{request.vehicle, request.firstDay, request.days, llround(cost * 100)});
+    }
+    if (revenue != nullptr) {
+        revenue->record(vehicle.type(), vehicle.year, llround(cost * 100));
+    }
+    return {true, cost, handle};
+}
+
+bool BookingService::cancel(BookingHandle handle) {
+    LiveBooking booking;
+    {
+        BookingShard& shard = shards[handle.id % shardCount];
+        lock_guard<mutex> lock(shard.lock);
+        auto found = shard.bookings.find(handle.id);
+        if (found == shard.bookings.end()) {
+            return false;
+        }
+        booking = found->second;
+        shard.bookings.erase(found);
+    }
+    calendars[booking.vehicle].release(booking.firstDay, booking.days);
+    // Only a booking that was really made gets here, so the totals never drop below what was earned
+    if (revenue != nullptr) {
+        const Vehicle& vehicle = *fleet[booking.vehicle];
+        revenue->record(vehicle.type(), vehicle.year, -booking.cents, -1);
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Booking files
+// ---------------------------------------------------------------------------------------------
+
+bool BookingFileReader::parseLine(const char* line, const char* lineEnd, RentalRequest& request, uint64_t& customerId) {
+    if (lineEnd > line && lineEnd[-1] == '\r') lineEnd--;
+    const char* field = line;
+    const char* comma = static_cast<const char*>(memchr(field, ',', lineEnd - field));
+    if (comma == nullptr) return false;
+
+    // Vehicle type, as a menu number or a name
+    string_view typeText(field, comma - field);
+    if (typeText == "1" || typeText == "Car") request.type = VehicleType::Car;
+    else if (typeText == "2" || typeText == "SUV") request.type = VehicleType::SUV;
+    else if (typeText == "3" || typeText == "Truck") request.type = VehicleType::Truck;
+    else return false;
+
+    auto days = from_chars(comma + 1, lineEnd, request.days);
+    if (days.ec != errc() || days.ptr == lineEnd || *days.ptr != ',' || request.days <= 0) return false;
+    auto customer = from_chars(days.ptr + 1, lineEnd, customerId);
+    return customer.ec == errc() && customer.ptr == lineEnd;
+}
+
+BookingFileReader::BookingFileReader(const string& path) : file(path) {
+    cursor = file.data();
+    end = file.data() + file.size();
+    binary = file.size() >= sizeof(binaryBookingMagic) && memcmp(cursor, binaryBookingMagic, sizeof(binaryBookingMagic)) == 0;
+    if (binary) {
+        cursor += sizeof(binaryBookingMagic);
+    } else if (file.view().starts_with("type,")) {
+        // Skip the CSV header line
+        const char* headerEnd = static_cast<const char*>(memchr(cursor, '\n', end - cursor));
+        cursor = headerEnd != nullptr ? headerEnd + 1 : end;
+    }
+}
+
+size_t BookingFileReader::read(RentalRequest* requests, uint64_t* customerIds, size_t maxCount) {
+    size_t count = 0;
+    if (binary) {
+        while (count < maxCount && end - cursor >= static_cast<ptrdiff_t>(sizeof(BinaryBooking))) {
+            BinaryBooking record;
+            memcpy(&record, cursor, sizeof(record));    // The mapping gives no alignment guarantee for records
+            cursor += sizeof(record);
+            if (record.type < 1 || record.type > 3 || record.days <= 0) {
+                rejectedCount++;
+                continue;
+            }
+            requests[count] = {static_cast<VehicleType>(record.type), record.days};
+            customerIds[count++] = record.customerId;
+        }
+        // A file cut short (e.g. a copy that did not finish) leaves part of a record behind, which is
+        // rejected like a malformed CSV line instead of being dropped without a word
+        if (count < maxCount && cursor < end) {
+            truncatedBytes = end - cursor;
+            rejectedCount++;
+            cursor = end;
+        }
+        return count;
+    }
+    while (count < maxCount && cursor < end) {
+        const char* lineEnd = static_cast<const char*>(memchr(cursor, '\n', end - cursor));
+        if (lineEnd == nullptr) lineEnd = end;
+        if (lineEnd != cursor) {
+            if (parseLine(cursor, lineEnd, requests[count], customerIds[count])) count++;
+            else rejectedCount++;
+        }
+        cursor = lineEnd < end ? lineEnd + 1 : end;
+    }
+    return count;
+}
@@ -0,0 +1,861 @@
+/*
+Vehicle hierarchy of the car rental program (question 1), with everything built on it:
+the pricing policies and vector pricing kernels, the batch pricer, the column-layout FleetStore,
+lock-free reservation calendars with the BookingService, and the booking file reader.
+*/
+
+#ifndef VEHICLES_H
+#define VEHICLES_H
+
+#include<algorithm>
+#include<atomic>
+#include<cmath>
+#include<condition_variable>
+#include<cstddef>
+#include<cstdint>
+#include<deque>
+#include<functional>
+#include<future>
+#include<memory>
+#include<memory_resource>
+#include<mutex>
+#include<span>
+#include<stdexcept>
+#include<string>
+#include<string_view>
+#include<thread>
+#include<unordered_map>
+#include<vector>
+#include "Arena.h"
+#include "FileIO.h"
+#include "Instrumentation.h"
+#include "StringMap.h"
+
+// The three kinds of vehicle in the fleet
+// The values match the numbers the customer types in the menu in main()
+enum class VehicleType : unsigned char { Car = 1, SUV = 2, Truck = 3 };
+
+// Maps a vehicle type to an index 1-3 for per-type tables of 4 entries, 0 for anything that is not a Car, SUV or Truck
+inline size_t vehicleTypeSlot(VehicleType type) {
+    unsigned value = static_cast<unsigned>(type);
+    return value <= 3 ? value : 0;
+}
+
+class Car;
+class SUV;
+class Truck;
+
+// Pricing policy for each type of vehicle
+// The rates and formulas are constexpr, so when the type of vehicle is known at compile time the price
+// is worked out inline with no virtual call at all (and with constant arguments, by the compiler itself).
+// Every pricing path in the program (objects, batch pricer, vector kernels) uses these formulas.
+template<typename VehicleKind>
+struct Pricing;
+
+template<>
+struct Pricing<Car> {
+    using Attribute = int;                      // Number of doors
+    static constexpr double costPerDay = 20.0;  // Cost per day for a car
+    static constexpr bool pricedPerTon = false;
+
+    static constexpr double rentalCost(int days, int numDoors) {
+        return costPerDay * days * numDoors;    // Number of doors affects cost
+    }
+};
+
+template<>
+struct Pricing<SUV> {
+    using Attribute = int;                      // Number of people
+    static constexpr double costPerDay = 30.0;  // Cost per day for an SUV
+    static constexpr bool pricedPerTon = false;
+
+    static constexpr double rentalCost(int days, int peopleCapacity) {
+        return costPerDay * days * peopleCapacity;  // Number of people affects cost
+    }
+};
+
+template<>
+struct Pricing<Truck> {
+    using Attribute = float;                        // Cargo capacity in kilograms
+    static constexpr double costPerDay = 50.0;      // Cost per day for a truck
+    static constexpr double kilogramsPerTon = 1000.0;
+    static constexpr bool pricedPerTon = true;
+
+    static constexpr double rentalCost(int days, float cargoCapacity) {
+        return costPerDay * days * cargoCapacity / kilogramsPerTon;    // Cargo weight (in tons) affects cost
+    }
+};
+
+// The rate tables are checked by the compiler, so a wrong rate fails the build instead of a customer's bill
+static_assert(Pricing<Car>::rentalCost(3, 4) == 240.0, "3 days in a 4 door car costs KES 240");
+static_assert(Pricing<SUV>::rentalCost(2, 7) == 420.0, "2 days in a 7 seat SUV costs KES 420");
+static_assert(Pricing<Truck>::rentalCost(7, 5000.0f) == 1750.0, "7 days in a 5 ton truck costs KES 1750");
+
+
+class Vehicle {
+    public:
+        std::pmr::string make, model;    // pmr strings, so the characters can live in an arena with the object (see Arena.h)
+        int year;
+
+        // The strings are allocated from memory: the normal heap unless an arena is passed in
+        explicit Vehicle(std::pmr::memory_resource* memory = std::pmr::get_default_resource()) : make(memory), model(memory) {}
+
+        Vehicle(std::string_view make, std::string_view model, int year, std::pmr::memory_resource* memory)
+            : make(make, memory), model(model, memory), year(year) {}
+    
+        //A virtual function is a member function of a base class that can be overridden in a derived class.
+        // It allows dynamic (runtime) polymorphism, i.e. the function that gets executed is determined at runtime based on the actual object type.
+        virtual void calculateRentalCost(int days) = 0;    // Pure Virtual function declaration
+
+        // Same price as calculateRentalCost but returned instead of printed
+        // This lets a caller price many quotes without writing (and flushing) a line to the screen for each one
+        // Money is kept in double: a float only has 24 bits of precision and starts losing shillings once totals pass about 16 million
+        virtual double quoteRentalCost(int days) const = 0;
+
+        // Which kind of vehicle this is, so code holding a Vehicle* can tell without a dynamic_cast
+        virtual VehicleType type() const = 0;
+
+        // Destructor for Vehicle class
+        // After the programme runs successfully, run the destructor to clear memory
+        // The ~Vehicle() destructor is called multiple times because each derived class (Car, SUV, Truck) calls the base class destructor (Vehicle's destructor) as part of its destruction process.
+        virtual ~Vehicle() {
+            // cout << "Vehicle Destructor Called!" << endl;
+        }
+};
+
+// Derived class
+// Car is a derived/child/sub class of the base/parent/super class Car
+class Car : public Vehicle {
+
+    private:
+        int numDoors = 4;      // Number of doors the Car has
+
+    public:
+        // Constructor to initialize the car details
+        // We overide the variable values in vehicle class if default values are placed
+        Car() {
+            make = "Toyota";
+            model = "Corolla";
+            year = 2020;
+        }
+
+        // Constructor for any car in the fleet
+        Car(std::string_view make, std::string_view model, int year, int numDoors, std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+            : Vehicle(make, model, year, memory), numDoors(numDoors) {}
+
+        VehicleType type() const override { return VehicleType::Car; }
+
+        // Getter for the number of doors, used by the batch pricer
+        int getNumDoors() const { return numDoors; }
+
+        // Price worked out with the Car pricing policy above
+        double quoteRentalCost(int days) const override {
+            return Pricing<Car>::rentalCost(days, numDoors);
+        }
+
+       // Overriding the base class function to calculate rental cost based on number of doors for this class function
+        void calculateRentalCost(int days) override;
+
+        // Destructor for Car class
+        // After the programme runs successfully, run the destructor to clear memory
+        // The destructor for the derived class is called first, followed by the base class destructor. This ensures that all resources are properly released.
+        ~Car() {
+            // cout << "Car Destructor Called!" << endl;
+        }
+};
+
+
+class SUV : public Vehicle {
+    private:
+     int peopleCapacity = 7;        // Number of people the SUV can carry
+
+    public:
+        // Constructor to initialize the SUV details
+        // We overide the variable values in vehicle class if default values are placed
+        SUV() {
+            make = "Honda";
+            model = "Pilot";
+            year = 2022;
+        }
+
+        // Constructor for any SUV in the fleet
+        SUV(std::string_view make, std::string_view model, int year, int peopleCapacity, std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+            : Vehicle(make, model, year, memory), peopleCapacity(peopleCapacity) {}
+
+        VehicleType type() const override { return VehicleType::SUV; }
+
+        // Getter for the number of people, used by the batch pricer
+        int getPeopleCapacity() const { return peopleCapacity; }
+
+        // Price worked out with the SUV pricing policy above
+        double quoteRentalCost(int days) const override {
+            return Pricing<SUV>::rentalCost(days, peopleCapacity);
+        }
+
+        // Overriding the base class function to calculate rental cost based on number of people
+        void calculateRentalCost(int days) override;
+
+        // Destructor for SUV class
+        // After the programme runs successfully, run the destructor to clear memory
+        // The destructor for the derived class is called first, followed by the base class destructor. This ensures that all resources are properly released.
+        ~SUV() {
+            // cout << "SUV Destructor Called!" << endl;
+        }
+};
+
+class Truck : public Vehicle {    
+    private:
+     float cargoCapacity = 5000;   // Weight of the cargo the truck can carry in kilograms
+
+    public:
+        // Constructor to initialize the truck details
+        // We overide the variable values in vehicle class if default values are placed
+        Truck() {
+            make = "Ford";
+            model = "F-150";
+            year = 2021;
+        }
+
+        // Constructor for any truck in the fleet
+        Truck(std::string_view make, std::string_view model, int year, float cargoCapacity, std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+            : Vehicle(make, model, year, memory), cargoCapacity(cargoCapacity) {}
+
+        VehicleType type() const override { return VehicleType::Truck; }
+
+        // Getter for the cargo capacity, used by the batch pricer
+        float getCargoCapacity() const { return cargoCapacity; }
+
+        // Price worked out with the Truck pricing policy above
+        double quoteRentalCost(int days) const override {
+            return Pricing<Truck>::rentalCost(days, cargoCapacity);
+        }
+
+        // Overriding the base class function to calculate rental cost based on cargo capacity
+        void calculateRentalCost(int days) override;
+
+        // Destructor for Truck class
+        // After the programme runs successfully, run the destructor to clear memory
+        // The destructor for the derived class is called first, followed by the base class destructor. This ensures that all resources are properly released.
+        ~Truck() {
+            // cout << "Truck Destructor Called!" << endl;
+        }
+};
+
+
+// ---------------------------------------------------------------------------------------------
+// Pricing kernels
+// Each kernel prices a whole array of rentals of one vehicle type: costs[i] = formula(days[i], attribute[i]).
+// The vector versions do the same double operations in the same order as the scalar formulas
+// (costPerDay * days, times the attribute, then / 1000 for trucks). IEEE multiply and divide are
+// exactly rounded and there are no additions to fuse, so SSE2 and AVX2 give bit-for-bit the scalar result.
+// ---------------------------------------------------------------------------------------------
+
+// Instruction sets a kernel can be run with, slowest first
+enum class KernelIsa { Scalar, SSE2, AVX2 };
+
+// Name of an instruction set, for reports
+const char* kernelIsaName(KernelIsa isa);
+
+// Best instruction set this CPU supports, detected once at runtime
+KernelIsa bestKernelIsa();
+
+// Public kernels, one per vehicle type. Same results as Pricing<Car/SUV/Truck>::rentalCost for every element.
+// Pass attributeStride = 0 to price every rental with the single attribute value *numDoors (etc.).
+void carRentalCosts(const int* days, const int* numDoors, size_t attributeStride, double* costs, size_t count, KernelIsa isa = bestKernelIsa());
+void suvRentalCosts(const int* days, const int* peopleCapacity, size_t attributeStride, double* costs, size_t count, KernelIsa isa = bestKernelIsa());
+void truckRentalCosts(const int* days, const float* cargoCapacity, size_t attributeStride, double* costs, size_t count, KernelIsa isa = bestKernelIsa());
+
+// Adds up a batch of costs exactly, as whole cents in a 64 bit integer
+// Summing millions of doubles one by one lets rounding errors pile up; integer cents do not drift.
+long long totalCents(std::span<const double> costs);
+
+// One booking request in a batch: which type of vehicle and for how many days
+struct RentalRequest {
+    VehicleType type;
+    int days;
+};
+
+// Prices a whole batch of rental requests in one call.
+// The requests are first grouped by vehicle type, then each group is priced in its own tight loop
+// with that type's attributes loaded once. There is no virtual call and no stream write per quote.
+class BatchPricer {
+    private:
+        int numDoors;           // Attributes of the fleet vehicles the quotes are for
+        int peopleCapacity;
+        float cargoCapacity;
+        std::vector<unsigned> order;     // Request positions sorted by type, reused between calls
+
+    public:
+        // The pricer copies the attributes out of one vehicle of each type
+        BatchPricer(const Car& car, const SUV& suv, const Truck& truck)
+            : numDoors(car.getNumDoors()), peopleCapacity(suv.getPeopleCapacity()), cargoCapacity(truck.getCargoCapacity()) {}
+
+        // Writes the cost of requests[i] into costs[i], the same value quoteRentalCost would give
+        // A request with an unknown vehicle type gets a cost of 0
+        void priceBatch(std::span<const RentalRequest> requests, std::span<double> costs);
+};
+
+
+// Turns repeated strings (makes and models) into small integer ids
+// A fleet has only a few hundred distinct makes and models, so each vehicle can store a 4 byte id instead of a std::string
+class StringInterner {
+    private:
+        StringMap<uint32_t> ids;            // Searched with a string_view, so finding a name already interned allocates nothing
+        std::vector<std::string> names;   // names[id] is the string for that id
+
+    public:
+        // Returns the id for name, giving it a new id the first time it is seen
+        uint32_t intern(std::string_view name) {
+            auto found = ids.find(name);
+            if (found != ids.end()) {
+                return found->second;
+            }
+            uint32_t id = names.size();
+            names.emplace_back(name);
+            ids.emplace(names.back(), id);
+            return id;
+        }
+
+        const std::string& name(uint32_t id) const { return names.at(id); }
+
+        size_t size() const { return names.size(); }
+
+        // Approximate heap bytes used (strings, vector and hash table nodes)
+        size_t memoryFootprint() const {
+            size_t bytes = names.capacity() * sizeof(std::string) + ids.bucket_count() * sizeof(void*);
+            for (const std::string& name : names) {
+                bytes += 2 * name.capacity() + sizeof(std::string) + sizeof(uint32_t) + 2 * sizeof(void*);
+            }
+            return bytes;
+        }
+};
+
+// Stable handle to a vehicle in a FleetStore
+using VehicleId = uint32_t;
+
+// Structure-of-arrays table for one type of vehicle
+// Row r of the table is id[r], make[r], model[r], year[r] and attribute[r],
+// so a scan over one column (e.g. year) reads contiguous memory only.
+template<typename Attribute>
+struct VehicleColumns {
+    std::vector<VehicleId> id;
+    std::vector<uint32_t> make, model;   // Interned ids from the store's StringInterner
+    std::vector<int> year;
+    std::vector<Attribute> attribute;    // numDoors, peopleCapacity or cargoCapacity depending on the table
+
+    size_t size() const { return id.size(); }
+
+    void push(VehicleId vehicle, uint32_t makeId, uint32_t modelId, int vehicleYear, Attribute value) {
+        id.push_back(vehicle);
+        make.push_back(makeId);
+        model.push_back(modelId);
+        year.push_back(vehicleYear);
+        attribute.push_back(value);
+    }
+
+    // Removes a row by moving the last row into its place, so the columns stay contiguous
+    void swapRemove(size_t row) {
+        id[row] = id.back();                id.pop_back();
+        make[row] = make.back();            make.pop_back();
+        model[row] = model.back();          model.pop_back();
+        year[row] = year.back();            year.pop_back();
+        attribute[row] = attribute.back();  attribute.pop_back();
+    }
+
+    size_t memoryFootprint() const {
+        return id.capacity() * sizeof(VehicleId) + (make.capacity() + model.capacity()) * sizeof(uint32_t)
+             + year.capacity() * sizeof(int) + attribute.capacity() * sizeof(Attribute);
+    }
+};
+
+// Fleet of vehicles kept in a cache-friendly column layout instead of one heap object per vehicle
+// Each type has its own table, and the typeOf/rowOf columns say where each VehicleId lives.
+class FleetStore {
+    private:
+        StringInterner strings;
+        VehicleColumns<int> cars;       // attribute = numDoors
+        VehicleColumns<int> suvs;       // attribute = peopleCapacity
+        VehicleColumns<float> trucks;   // attribute = cargoCapacity (kg)
+        std::vector<VehicleType> typeOf;     // Type tag of each VehicleId, 0 once the vehicle has been removed
+        std::vector<uint32_t> rowOf;         // Row of each VehicleId in its type's table
+        std::vector<VehicleId> freeIds;      // Ids of removed vehicles, handed out again by add
+
+        VehicleId newId(VehicleType type, uint32_t row) {
+            if (!freeIds.empty()) {
+                VehicleId id = freeIds.back();
+                freeIds.pop_back();
+                typeOf[id] = type;
+                rowOf[id] = row;
+                return id;
+            }
+            typeOf.push_back(type);
+            rowOf.push_back(row);
+            return typeOf.size() - 1;
+        }
+
+        // Appends rows to out for vehicles newer than newerThan with attribute >= minAttribute
+        // The loop has no branch on the data: every row is written and the cursor only moves on a match.
+        template<typename Attribute>
+        static void scan(const VehicleColumns<Attribute>& table, int newerThan, Attribute minAttribute, std::vector<VehicleId>& out) {
+            size_t found = out.size();
+            out.resize(found + table.size());
+            const VehicleId* ids = table.id.data();
+            const int* years = table.year.data();
+            const Attribute* attributes = table.attribute.data();
+            VehicleId* result = out.data();
+            for (size_t row = 0; row < table.size(); row++) {
+                result[found] = ids[row];
+                found += (years[row] > newerThan) & (attributes[row] >= minAttribute);
+            }
+            out.resize(found);
+        }
+
+    public:
+        VehicleId addCar(std::string_view make, std::string_view model, int year, int numDoors) {
+            VehicleId id = newId(VehicleType::Car, cars.size());
+            cars.push(id, strings.intern(make), strings.intern(model), year, numDoors);
+            return id;
+        }
+
+        VehicleId addSUV(std::string_view make, std::string_view model, int year, int peopleCapacity) {
+            VehicleId id = newId(VehicleType::SUV, suvs.size());
+            suvs.push(id, strings.intern(make), strings.intern(model), year, peopleCapacity);
+            return id;
+        }
+
+        VehicleId addTruck(std::string_view make, std::string_view model, int year, float cargoCapacity) {
+            VehicleId id = newId(VehicleType::Truck, trucks.size());
+            trucks.push(id, strings.intern(make), strings.intern(model), year, cargoCapacity);
+            return id;
+        }
+
+        // Copies an existing Car, SUV or Truck object into the store
+        VehicleId add(const Vehicle& vehicle) {
+            switch (vehicle.type()) {
+                case VehicleType::Car:
+                    return addCar(vehicle.make, vehicle.model, vehicle.year, static_cast<const Car&>(vehicle).getNumDoors());
+                case VehicleType::SUV:
+                    return addSUV(vehicle.make, vehicle.model, vehicle.year, static_cast<const SUV&>(vehicle).getPeopleCapacity());
+                case VehicleType::Truck:
+                    return addTruck(vehicle.make, vehicle.model, vehicle.year, static_cast<const Truck&>(vehicle).getCargoCapacity());
+            }
+            throw std::invalid_argument("FleetStore::add: unknown vehicle type");
+        }
+
+        // Removes a vehicle, returns false if the id is not in the store
+        bool remove(VehicleId id) {
+            if (id >= typeOf.size() || static_cast<int>(typeOf[id]) == 0) {
+                return false;
+            }
+            uint32_t row = rowOf[id];
+            switch (typeOf[id]) {
+                case VehicleType::Car:   cars.swapRemove(row);   if (row < cars.size())   rowOf[cars.id[row]] = row;   break;
+                case VehicleType::SUV:   suvs.swapRemove(row);   if (row < suvs.size())   rowOf[suvs.id[row]] = row;   break;
+                case VehicleType::Truck: trucks.swapRemove(row); if (row < trucks.size()) rowOf[trucks.id[row]] = row; break;
+            }
+            typeOf[id] = VehicleType{};
+            freeIds.push_back(id);
+            return true;
+        }
+
+        bool contains(VehicleId id) const { return id < typeOf.size() && static_cast<int>(typeOf[id]) != 0; }
+
+        VehicleType typeOfVehicle(VehicleId id) const { return typeOf.at(id); }
+
+        size_t size() const { return cars.size() + suvs.size() + trucks.size(); }
+
+        size_t count(VehicleType type) const {
+            switch (type) {
+                case VehicleType::Car:   return cars.size();
+                case VehicleType::SUV:   return suvs.size();
+                case VehicleType::Truck: return trucks.size();
+            }
+            return 0;
+        }
+
+        // Read-only access to each type's columns, for iterating over one type at a time
+        const VehicleColumns<int>& carColumns() const { return cars; }
+        const VehicleColumns<int>& suvColumns() const { return suvs; }
+        const VehicleColumns<float>& truckColumns() const { return trucks; }
+        const StringInterner& names() const { return strings; }
+
+        // Calls visit(id, make, model, year, attribute) for every vehicle of one type
+        template<typename Visitor>
+        void forEach(VehicleType type, Visitor visit) const {
+            auto walk = [&](const auto& table) {
+                for (size_t row = 0; row < table.size(); row++) {
+                    visit(table.id[row], strings.name(table.make[row]), strings.name(table.model[row]), table.year[row], table.attribute[row]);
+                }
+            };
+            switch (type) {
+                case VehicleType::Car:   walk(cars);   break;
+                case VehicleType::SUV:   walk(suvs);   break;
+                case VehicleType::Truck: walk(trucks); break;
+            }
+        }
+
+        // Filter scans: vehicles of one type newer than a year with at least the given attribute
+        // e.g. findSUVs(2020, 7, out) finds all SUVs newer than 2020 that carry 7 or more people
+        void findCars(int newerThan, int minDoors, std::vector<VehicleId>& out) const { scan(cars, newerThan, minDoors, out); }
+        void findSUVs(int newerThan, int minPeople, std::vector<VehicleId>& out) const { scan(suvs, newerThan, minPeople, out); }
+        void findTrucks(int newerThan, float minCargo, std::vector<VehicleId>& out) const { scan(trucks, newerThan, minCargo, out); }
+
+        // Approximate bytes used by the columns and the string interner
+        size_t memoryFootprint() const {
+            return cars.memoryFootprint() + suvs.memoryFootprint() + trucks.memoryFootprint()
+                 + typeOf.capacity() * sizeof(VehicleType) + rowOf.capacity() * sizeof(uint32_t)
+                 + freeIds.capacity() * sizeof(VehicleId) + strings.memoryFootprint();
+        }
+};
+
+
+// ---------------------------------------------------------------------------------------------
+// Revenue aggregates
+// Running revenue totals for the dashboards, kept up to date as each booking is made instead of
+// being recomputed from the booking history. Every total is a relaxed atomic, so any thread can
+// read a total while others are adding to it; a reader never waits and never sees a torn value.
+// ---------------------------------------------------------------------------------------------
+
+// Revenue and number of bookings behind one total
+struct RevenueTotal {
+    long long cents = 0;
+    long long bookings = 0;
+};
+
+// Revenue per vehicle type and per model year, in whole cents
+// The totals are kept in a fixed type x year table, so recording a booking is two atomic adds
+// and a query adds up at most yearCount cells, however many bookings have been recorded.
+// Tables are mergeable: per-branch or per-thread tables can be summed into one with merge().
+class FleetRevenue {
+    public:
+        static constexpr int firstYear = 1970;
+        static constexpr int yearCount = 128;      // Model years 1970-2097; years outside that are counted at the nearest end
+
+    private:
+        struct Cell {
+            std::atomic<long long> cents{0};
+            std::atomic<long long> bookings{0};
+        };
+        Cell cells[4][yearCount];                   // cells[type][year - firstYear], row 0 collects unknown types
+
+        static size_t yearSlot(int year) {
+            return static_cast<size_t>(std::clamp(year - firstYear, 0, yearCount - 1));
+        }
+
+        static RevenueTotal read(const Cell& cell) {
+            return {cell.cents.load(std::memory_order_relaxed), cell.bookings.load(std::memory_order_relaxed)};
+        }
+
+    public:
+        // Adds one booking. A cancelled booking is taken off again with its negative cents and bookings = -1.
+        void record(VehicleType type, int year, long long cents, long long bookings = 1) {
+            Cell& cell = cells[vehicleTypeSlot(type)][yearSlot(year)];
+            cell.cents.fetch_add(cents, std::memory_order_relaxed);
+            cell.bookings.fetch_add(bookings, std::memory_order_relaxed);
+        }
+
+        void record(const Vehicle& vehicle, double cost) {
+            record(vehicle.type(), vehicle.year, std::llround(cost * 100));
+        }
+
+        // Adds every total of other into this table
+        void merge(const FleetRevenue& other) {
+            for (size_t t = 0; t < 4; t++) {
+                for (size_t y = 0; y < yearCount; y++) {
+                    RevenueTotal total = read(other.cells[t][y]);
+                    cells[t][y].cents.fetch_add(total.cents, std::memory_order_relaxed);
+                    cells[t][y].bookings.fetch_add(total.bookings, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        RevenueTotal forTypeAndYear(VehicleType type, int year) const {
+            return read(cells[vehicleTypeSlot(type)][yearSlot(year)]);
+        }
+
+        RevenueTotal forType(VehicleType type) const {
+            RevenueTotal total;
+            for (const Cell& cell : cells[vehicleTypeSlot(type)]) {
+                RevenueTotal part = read(cell);
+                total.cents += part.cents;
+                total.bookings += part.bookings;
+            }
+            return total;
+        }
+
+        RevenueTotal forYear(int year) const {
+            RevenueTotal total;
+            for (const auto& row : cells) {
+                RevenueTotal part = read(row[yearSlot(year)]);
+                total.cents += part.cents;
+                total.bookings += part.bookings;
+            }
+            return total;
+        }
+
+        // Totals are read one cell at a time, so while writers are busy the sum of the parts may be
+        // a few bookings behind or ahead of another reader's; once they stop every total is exact.
+        RevenueTotal overall() const {
+            RevenueTotal total;
+            for (const auto& row : cells) {
+                for (const Cell& cell : row) {
+                    RevenueTotal part = read(cell);
+                    total.cents += part.cents;
+                    total.bookings += part.bookings;
+                }
+            }
+            return total;
+        }
+};
+
+// ---------------------------------------------------------------------------------------------
+// Bookings
+// Many threads can book the same vehicles at once. Each vehicle has a calendar with one bit per day,
+// and a booking claims its date range with compare-and-swap, so two bookings can never both own a day.
+// ---------------------------------------------------------------------------------------------
+
+// Days are counted from the first day the agency takes bookings for (day 0)
+// Requests past the horizon are refused.
+class ReservationCalendar {
+    public:
+        static constexpr int horizonDays = 512;
+
+    private:
+        static constexpr int wordCount = horizonDays / 64;
+        std::atomic<uint64_t> words[wordCount] = {};     // Bit d % 64 of words[d / 64] is set when day d is booked
+
+        // Bits of word w that fall inside days [firstDay, endDay)
+        static uint64_t rangeMask(int w, int firstDay, int endDay) {
+            int low = std::max(firstDay - w * 64, 0);
+            int high = std::min(endDay - w * 64, 64);
+            uint64_t upTo = high == 64 ? ~uint64_t(0) : (uint64_t(1) << high) - 1;
+            return upTo & ~((uint64_t(1) << low) - 1);
+        }
+
+    public:
+        // True if [firstDay, firstDay + days) is a non-empty range inside the horizon
+        // Compared as days > horizonDays - firstDay, since firstDay + days can overflow for a huge days.
+        static bool validRange(int firstDay, int days) {
+            return firstDay >= 0 && firstDay < horizonDays && days > 0 && days <= horizonDays - firstDay;
+        }
+
+        // Claims days [firstDay, firstDay + days) if all of them are free, lock-free
+        // Each 64 day word is claimed with a CAS; if a later word is already taken, the words claimed so far are given back.
+        // A competing booking that sees those bits in the meantime is refused, but no day is ever owned twice.
+        bool tryClaim(int firstDay, int days) {
+            if (!validRange(firstDay, days)) {
+                return false;
+            }
+            const int endDay = firstDay + days;
+            const int firstWord = firstDay / 64, lastWord = (endDay - 1) / 64;
+            for (int w = firstWord; w <= lastWord; w++) {
+                const uint64_t mask = rangeMask(w, firstDay, endDay);
+                uint64_t current = words[w].load(std::memory_order_relaxed);
+                do {
+                    if (current & mask) {
+                        for (int undo = firstWord; undo < w; undo++) {
+                            words[undo].fetch_and(~rangeMask(undo, firstDay, endDay), std::memory_order_release);
+                        }
+                        return false;
+                    }
+                } while (!words[w].compare_exchange_weak(current, current | mask, std::memory_order_acq_rel, std::memory_order_relaxed));
+            }
+            return true;
+        }
+
+        // Frees days [firstDay, firstDay + days), e.g. when a booking is cancelled
+        // A range outside the horizon is ignored, like tryClaim refuses it.
+        void release(int firstDay, int days) {
+            if (!validRange(firstDay, days)) {
+                return;
+            }
+            const int endDay = firstDay + days;
+            for (int w = firstDay / 64; w <= (endDay - 1) / 64; w++) {
+                words[w].fetch_and(~rangeMask(w, firstDay, endDay), std::memory_order_release);
+            }
+        }
+
+        bool isBooked(int day) const {
+            return (words[day / 64].load(std::memory_order_acquire) >> (day % 64)) & 1;
+        }
+
+        int bookedDays() const {
+            int total = 0;
+            for (const auto& word : words) total += __builtin_popcountll(word.load(std::memory_order_acquire));
+            return total;
+        }
+};
+
+// Fixed set of worker threads taking jobs from a shared queue
+class ThreadPool {
+    private:
+        std::vector<std::thread> workers;
+        std::deque<std::function<void()>> jobs;
+        std::mutex jobsLock;
+        std::condition_variable jobReady;
+        bool stopping = false;
+
+        void work() {
+            while (true) {
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock(jobsLock);
+                    jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+                    if (jobs.empty()) return;   // Stopping and nothing left to do
+                    job = std::move(jobs.front());
+                    jobs.pop_front();
+                }
+                job();
+            }
+        }
+
+    public:
+        explicit ThreadPool(unsigned threadCount) {
+            for (unsigned i = 0; i < std::max(threadCount, 1u); i++) {
+                workers.emplace_back([this] { work(); });
+            }
+        }
+
+        // Finishes the jobs already queued, then joins the workers
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(jobsLock);
+                stopping = true;
+            }
+            jobReady.notify_all();
+            for (std::thread& worker : workers) worker.join();
+        }
+
+        void submit(std::function<void()> job) {
+            {
+                std::lock_guard<std::mutex> lock(jobsLock);
+                jobs.push_back(std::move(job));
+            }
+            jobReady.notify_one();
+        }
+
+        size_t size() const { return workers.size(); }
+};
+
+// A customer asking for one vehicle of the fleet for a range of days
+struct BookingRequest {
+    uint32_t vehicle;       // Index into the fleet given to the BookingService
+    int firstDay;
+    int days;
+    uint64_t customerId;
+};
+
+// Proof of a booking that was really made, the only thing BookingService::cancel accepts
+struct BookingHandle {
+    uint64_t id = 0;        // 0 when nothing was booked
+};
+
+struct BookingResult {
+    bool booked;            // False if any of the days were already taken (or the request was invalid)
+    double cost;            // Rental cost when booked, 0 otherwise
+    BookingHandle handle;   // For cancelling the booking later
+};
+
+// Takes booking requests from any number of threads and runs them on a thread pool
+// The reservation table is lock-free, so workers booking different (or the same) vehicles never wait on each other.
+class BookingService {
+    private:
+        std::vector<const Vehicle*> fleet;                   // Not owned, must outlive the service
+        std::unique_ptr<ReservationCalendar[]> calendars;    // calendars[i] belongs to fleet[i]
+        FleetRevenue* revenue = nullptr;                     // Not owned, updated by every booking and cancellation if set
+
+        // Bookings that have been made and not cancelled, by handle id
+        // A cancel looks its booking up here, so it can only free days that booking claimed, and only once.
+        // The table is split into shards with a lock each, so bookings of different shards never wait on each other.
+        struct LiveBooking {
+            uint32_t vehicle;
+            int firstDay;
+            int days;
+            long long cents;        // Revenue recorded for it, taken off again exactly when it is cancelled
+        };
+        struct BookingShard {
+            std::mutex lock;
+            std::unordered_map<uint64_t, LiveBooking> bookings;
+        };
+        static constexpr size_t shardCount = 64;
+        std::unique_ptr<BookingShard[]> shards;
+        std::atomic<uint64_t> nextBookingId{1};
+
+        ThreadPool pool;                                // Declared last so it is joined before the calendars are freed
+
+    public:
+        BookingService(std::vector<const Vehicle*> vehicles, unsigned threadCount = std::thread::hardware_concurrency())
+            : fleet(std::move(vehicles)), calendars(new ReservationCalendar[fleet.size()]), shards(new BookingShard[shardCount]), pool(threadCount) {}
+
+        // Books on the calling thread
+        BookingResult bookNow(const BookingRequest& request);
+
+        // Books on a pool thread and calls done(result) there when finished
+        void submit(const BookingRequest& request, std::function<void(const BookingResult&)> done) {
+            pool.submit([this, request, done = std::move(done)] { done(bookNow(request)); });
+        }
+
+        // Books on a pool thread, the result arrives through the future
+        std::future<BookingResult> book(const BookingRequest& request) {
+            auto promised = std::make_shared<std::promise<BookingResult>>();
+            std::future<BookingResult> result = promised->get_future();
+            submit(request, [promised](const BookingResult& outcome) { promised->set_value(outcome); });
+            return result;
+        }
+
+        // Cancels a booking made by bookNow, submit or book, freeing exactly the days it claimed
+        // Returns false, and changes nothing, for a handle of a refused booking or one already cancelled.
+        bool cancel(BookingHandle handle);
+
+        // Keeps totals up to date with every booking from now on; call before any booking is made
+        void trackRevenue(FleetRevenue* totals) { revenue = totals; }
+
+        const ReservationCalendar& calendar(uint32_t vehicle) const { return calendars[vehicle]; }
+        size_t fleetSize() const { return fleet.size(); }
+        size_t threadCount() const { return pool.size(); }
+};
+
+// ---------------------------------------------------------------------------------------------
+// Booking files
+// The batch mode prices a whole file of bookings instead of asking one customer at a time.
+// A booking file is either CSV text, one "type,days,customerId" line per booking (type is 1/2/3 or Car/SUV/Truck),
+// or binary: the 8 byte magic "RIMSBK01" followed by BinaryBooking records.
+// ---------------------------------------------------------------------------------------------
+
+struct BinaryBooking {
+    uint64_t customerId;
+    int32_t days;
+    uint8_t type;           // 1 = Car, 2 = SUV, 3 = Truck
+    uint8_t padding[3];
+};
+static_assert(sizeof(BinaryBooking) == 16, "binary booking records are 16 bytes");
+
+inline constexpr char binaryBookingMagic[8] = {'R', 'I', 'M', 'S', 'B', 'K', '0', '1'};
+
+// Reads bookings straight out of a memory-mapped file, without copying lines into strings
+class BookingFileReader {
+    private:
+        MappedFile file;
+        const char* cursor;
+        const char* end;
+        bool binary;
+        size_t rejectedCount = 0;   // Lines or records that were not a valid booking
+        size_t truncatedBytes = 0;  // Bytes of a partial record at the end of a binary file
+
+        // Parses one CSV line [line, lineEnd), returns false if it is not a valid booking (e.g. a header line)
+        static bool parseLine(const char* line, const char* lineEnd, RentalRequest& request, uint64_t& customerId);
+
+    public:
+        explicit BookingFileReader(const std::string& path);
+
+        // Reads up to maxCount bookings, returns how many were read (0 at the end of the file)
+        size_t read(RentalRequest* requests, uint64_t* customerIds, size_t maxCount);
+
+        size_t rejected() const { return rejectedCount; }
+        // Non-zero if a binary file ends part way through a record (it is also counted in rejected())
+        size_t truncated() const { return truncatedBytes; }
+        size_t fileSize() const { return file.size(); }
+        bool isBinary() const { return binary; }
+};
+
+#endif
@@ -0,0 +1,46 @@
+# Checks that RIMS_INSTRUMENTATION=OFF really compiles the instrumentation out of the libraries.
+#
+# Builds the vehicles and exams libraries with instrumentation off in BINARY_DIR, then lists their symbols:
+# no ScopedTimer destructor (the clock reads and the record call), per-thread slots or registry may be left.
+# If the libraries of the enabled build are given too, the same symbols must be found in them, so the
+# check is known to be looking for the right names.
+#
+# Run with: cmake -DSOURCE_DIR=... -DBINARY_DIR=... -DCXX=... -DNM=... [-DENABLED_LIBRARIES="a.a;b.a"] -P CheckInstrumentationOff.cmake
+
+set(pattern "instrumentation::(ScopedTimer::~ScopedTimer|ThreadSlots|ThreadHistogram|threadSlots|Registry)")
+
+function(instrumentation_symbols output)
+    execute_process(COMMAND "${NM}" -C ${ARGN} OUTPUT_VARIABLE symbols RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${NM} failed on ${ARGN}")
+    endif()
+    string(REGEX MATCHALL "${pattern}[^\n]*" found "${symbols}")
+    set(${output} "${found}" PARENT_SCOPE)
+endfunction()
+
+execute_process(COMMAND "${CMAKE_COMMAND}" -S "${SOURCE_DIR}" -B "${BINARY_DIR}" -DCMAKE_BUILD_TYPE=Release
+                        -DCMAKE_CXX_COMPILER=${CXX} -DRIMS_INSTRUMENTATION=OFF
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Configuring the RIMS_INSTRUMENTATION=OFF build failed")
+endif()
+execute_process(COMMAND "${CMAKE_COMMAND}" --build "${BINARY_DIR}" --target vehicles exams RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Building the RIMS_INSTRUMENTATION=OFF libraries failed")
+endif()
+
+file(GLOB disabledLibraries "${BINARY_DIR}/*vehicles*" "${BINARY_DIR}/*exams*")
+instrumentation_symbols(found ${disabledLibraries})
+if(found)
+    list(JOIN found "\n  " lines)
+    message(FATAL_ERROR "Instrumentation left in the RIMS_INSTRUMENTATION=OFF libraries:\n  ${lines}")
+endif()
+
+if(ENABLED_LIBRARIES)
+    instrumentation_symbols(found ${ENABLED_LIBRARIES})
+    if(NOT found)
+        message(FATAL_ERROR "No instrumentation symbols in the enabled libraries either; the check is out of date")
+    endif()
+endif()
+
+message(STATUS "No instrumentation left in the RIMS_INSTRUMENTATION=OFF libraries")